@@ -14,4 +14,48 @@
 #define SERIAL_EXTRA_SUPPORT		1
 #define SERIAL_EXTRA_RX_BUF_SIZE	128
 
+#define HISTORY_BUF_SIZE		256
+#define HISTORY_EEPROM_SUPPORT		1
+#define HISTORY_EEPROM_ADDR		0x000
+
+#define SCRIPT_EEPROM_ADDR		0x100
+#define SCRIPT_EEPROM_SIZE		0x200
+
+#define WATCH_COLS			80
+
+#define RBUF_COUNT			3
+#define RBUF_SIZE			1024
+
+#define REGEX_PROG_SIZE		128
+#define REGEX_MAX_STATES		48
+
+#define GREP_HOLD_SIZE		128
+
+#define TAIL_BUF_SIZE		512
+
+#define CKSUM_BYTE_TABLE	1
+
+#define LZ_WINDOW_BITS		10
+#define LZ_LENGTH_BITS		5
+
+#define RENDER_CELL_BITS		4
+#define RENDER_PENDING_SIZE	64
+
+#define GAME_RECORD_SIZE		128
+
+#define SNAKE_MAX_WIDTH			100
+#define SNAKE_MAX_HEIGHT		24
+
+#define LIFE_WIDTH			128
+#define LIFE_HEIGHT			32
+
+#define LOGGER_EEPROM_ADDR		0x300
+#define LOGGER_EEPROM_SIZE		0x400
+
+#define EE_QUEUE_SIZE		128
+#define EE_QUEUE_SEGS		8
+
+#define EEFS_ADDR			0x700
+#define EEFS_SIZE			0x900
+
 #endif // _AVR_MCU_2560_H_
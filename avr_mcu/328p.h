@@ -13,4 +13,46 @@
 
 #define THERMAL_SUPPORT		1
 
+#define HISTORY_BUF_SIZE	96
+#define HISTORY_EEPROM_SUPPORT	1
+#define HISTORY_EEPROM_ADDR	0x000
+
+#define SCRIPT_EEPROM_ADDR	0x060
+#define SCRIPT_EEPROM_SIZE	0x0a0
+
+#define WATCH_COLS		32
+
+#define RBUF_COUNT		1
+#define RBUF_SIZE		256
+
+#define REGEX_PROG_SIZE	64
+#define REGEX_MAX_STATES	24
+
+#define GREP_HOLD_SIZE	64
+
+#define TAIL_BUF_SIZE	128
+
+#define LZ_WINDOW_BITS	8
+#define LZ_LENGTH_BITS	4
+
+#define RENDER_CELL_BITS	2
+#define RENDER_PENDING_SIZE	16
+
+#define GAME_RECORD_SIZE	16
+
+#define SNAKE_MAX_WIDTH	80
+#define SNAKE_MAX_HEIGHT	20
+
+#define LIFE_WIDTH	80
+#define LIFE_HEIGHT	20
+
+#define LOGGER_EEPROM_ADDR	0x100
+#define LOGGER_EEPROM_SIZE	0x100
+
+#define EE_QUEUE_SIZE	48
+#define EE_QUEUE_SEGS	4
+
+#define EEFS_ADDR		0x200
+#define EEFS_SIZE		0x200
+
 #endif // _AVR_MCU_328P_H_
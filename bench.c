@@ -0,0 +1,371 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "ee.h"
+#include "fix.h"
+#include "fmt.h"
+#include "rbuf.h"
+#include "regex.h"
+#include "rng.h"
+#include "serial.h"
+#include "thread.h"
+#include "timer.h"
+
+// "bench" times a fixed set of operations and shows the cycles each one takes,
+// one per row, in the same order and format every time so that runs can be
+// compared (on other MCUs, or before and after a change).
+//
+// Most are run with interrupts masked, timed from TCNT1 (which counts CPU
+// cycles), and with the time of an empty run taken off. These runs must stay
+// under 65536 cycles. Thread switches turn interrupts back on themselves, and
+// sending to the UART waits on the link, so those are timed with interrupts on.
+//
+// "-" is shown for anything which can't be run at the time: the UART while the
+// output is redirected, and the buffer write when no buffer is free.
+
+#define BENCH_NAME_WIDTH 22
+#define BENCH_VALUE_WIDTH 8
+
+#define BENCH_NONE 0xffffffff
+
+// Bytes sent ahead of the timed ones, so that the UART is already busy.
+#define BENCH_TX_PRIME 2
+#define BENCH_TX_BYTES 32
+
+#define BENCH_RBUF_NAME "bench"
+#define BENCH_RBUF_BYTES 64
+
+static const char GREP_PATTERN[] PROGMEM = "^t[a-z]* [0-9]+";
+static const char GREP_TEXT[] PROGMEM = "temp 23\r\nuptime 10:42\r\nload 4%\r\n";
+#define GREP_TEXT_LEN (sizeof(GREP_TEXT) - 1)
+
+
+static volatile bool _done;
+static volatile short _sink;
+static regex_prog_t* _re;
+static const char* _text;
+
+
+static unsigned long time_masked(void (*run)(unsigned short), unsigned short n);
+static unsigned short time_run(void (*run)(unsigned short), unsigned short n);
+static unsigned long bench_thread_switch(unsigned short n);
+static unsigned long bench_pipe(unsigned short n);
+static unsigned long bench_tx(unsigned short n);
+static unsigned long bench_tx_hook(unsigned short n);
+static unsigned long bench_rbuf();
+static unsigned long bench_grep();
+static unsigned long bench_ee_read(unsigned short n);
+static void switch_thread(void* arg);
+static void pipe_thread(void* arg);
+static void run_tx(unsigned short n);
+static void run_sprintf(unsigned short n);
+static void run_fmt(unsigned short n);
+static void run_tick_count(unsigned short n);
+static void run_rng(unsigned short n);
+static void run_fix12_mul(unsigned short n);
+static void run_grep(unsigned short n);
+static void run_ee_read(unsigned short n);
+static void drop_byte(unsigned char c);
+static void write_row(const char* name, unsigned long cycles, const char* unit);
+static void write_padded(const char* s, unsigned char width, bool right);
+
+
+void bench_main()
+{
+	write_padded(PSTR("op"), BENCH_NAME_WIDTH, false);
+	write_padded(PSTR("cycles"), BENCH_VALUE_WIDTH, true);
+	serial_write_newline();
+
+	write_row(PSTR("thread_switch"), bench_thread_switch(256), PSTR("/switch"));
+	write_row(PSTR("pipe round-trip"), bench_pipe(128), PSTR("/byte"));
+	write_row(PSTR("serial_tx_byte"), bench_tx(BENCH_TX_BYTES), PSTR("/byte"));
+	write_row(PSTR("serial_tx_byte hook"), bench_tx_hook(256), PSTR("/byte"));
+	write_row(PSTR("sprintf_P %u"), time_masked(&run_sprintf, 8), PSTR("/call"));
+	write_row(PSTR("fmt_u16"), time_masked(&run_fmt, 16), PSTR("/call"));
+	write_row(PSTR("timer_get_tick_count"), time_masked(&run_tick_count, 256), PSTR("/call"));
+	write_row(PSTR("rng_rand"), time_masked(&run_rng, 256), PSTR("/call"));
+	write_row(PSTR("fix12_mul"), time_masked(&run_fix12_mul, 256), PSTR("/call"));
+	write_row(PSTR("grep -E"), bench_grep(), PSTR("/KB"));
+	write_row(PSTR("rbuf write"), bench_rbuf(), PSTR("/byte"));
+	write_row(PSTR("ee_read"), bench_ee_read(256), PSTR("/byte"));
+}
+
+
+// Cycles per op, from n ops run with interrupts masked.
+static unsigned long time_masked(void (*run)(unsigned short), unsigned short n)
+{
+	const unsigned short t = time_run(run, n) - time_run(run, 0);
+	return ((unsigned long)t + (n >> 1)) / n;
+}
+
+static unsigned short time_run(void (*run)(unsigned short), unsigned short n)
+{
+	const unsigned char sreg = SREG;
+	cli();
+
+	const unsigned short t0 = TCNT1;
+	run(n);
+	const unsigned short t = TCNT1 - t0;
+
+	SREG = sreg;
+
+	return t;
+}
+
+// Each switch to the other thread comes straight back, so there are two per loop.
+static unsigned long bench_thread_switch(unsigned short n)
+{
+	_done = false;
+	thread_create(&switch_thread, 0);
+
+	const unsigned long c0 = timer_get_cycles();
+	for (unsigned short i = 0; i < n; i++)
+	{
+		thread_switch();
+	}
+	const unsigned long c = timer_get_cycles() - c0;
+
+	_done = true;
+	thread_join();
+
+	return c / (2 * n);
+}
+
+// A byte written into the pipe, and read by the other thread before it switches back.
+static unsigned long bench_pipe(unsigned short n)
+{
+	thread_create(&pipe_thread, 0);
+
+	const unsigned long c0 = timer_get_cycles();
+	for (unsigned short i = 0; i < n; i++)
+	{
+		thread_write_pipe('x');
+		thread_switch();
+	}
+	const unsigned long c = timer_get_cycles() - c0;
+
+	thread_join();
+
+	return c / n;
+}
+
+// Spaces and then a CR, which leave the line as it was. This is bound by the
+// baud rate, at 10 bits per byte.
+static unsigned long bench_tx(unsigned short n)
+{
+	if (serial_get_tx_hook() != 0)
+	{
+		return BENCH_NONE;
+	}
+
+	run_tx(BENCH_TX_PRIME);
+
+	const unsigned long c0 = timer_get_cycles();
+	run_tx(n);
+	const unsigned long c = timer_get_cycles() - c0;
+
+	serial_tx_byte('\r');
+
+	return c / n;
+}
+
+// The cost of serial_tx_byte() itself, with the bytes going to a hook which drops them.
+static unsigned long bench_tx_hook(unsigned short n)
+{
+	const serial_tx_hook_t hook = serial_get_tx_hook();
+	serial_set_tx_hook(&drop_byte);
+
+	const unsigned long c = time_masked(&run_tx, n);
+
+	serial_set_tx_hook(hook);
+
+	return c;
+}
+
+// Output redirected into a RAM buffer ("cmd > B"), which is freed again after.
+static unsigned long bench_rbuf()
+{
+	if (rbuf_exists(BENCH_RBUF_NAME) || !rbuf_start_write(BENCH_RBUF_NAME))
+	{
+		return BENCH_NONE;
+	}
+
+	const unsigned long c = time_masked(&run_tx, BENCH_RBUF_BYTES);
+
+	rbuf_end_write();
+	rbuf_delete(BENCH_RBUF_NAME);
+
+	return c;
+}
+
+// A few short lines through the regex matcher, as "grep -E" steps them.
+static unsigned long bench_grep()
+{
+	// Both are copied out of flash first, as grep has them in RAM.
+	char pattern[sizeof(GREP_PATTERN)];
+	char text[sizeof(GREP_TEXT)];
+	strcpy_P(pattern, GREP_PATTERN);
+	strcpy_P(text, GREP_TEXT);
+
+	regex_prog_t re;
+	regex_compile(&re, pattern, false);
+	_re = &re;
+	_text = text;
+
+	const unsigned short t = time_run(&run_grep, 1) - time_run(&run_grep, 0);
+
+	return ((unsigned long)t * 1024) / GREP_TEXT_LEN;
+}
+
+// Reads from the EEPROM itself, with no writes queued.
+static unsigned long bench_ee_read(unsigned short n)
+{
+	ee_flush();
+	return time_masked(&run_ee_read, n);
+}
+
+static void switch_thread(void* arg)
+{
+	while (!_done)
+	{
+		thread_switch();
+	}
+}
+
+static void pipe_thread(void* arg)
+{
+	while (thread_read_pipe() != 0x04)
+	{
+	}
+}
+
+static void run_tx(unsigned short n)
+{
+	for (unsigned short i = 0; i < n; i++)
+	{
+		serial_tx_byte(' ');
+	}
+}
+
+static void run_sprintf(unsigned short n)
+{
+	char buf[FMT_U32_MAX_LEN];
+	for (unsigned short i = 0; i < n; i++)
+	{
+		sprintf_P(buf, PSTR("%u"), 12345);
+	}
+}
+
+static void run_fmt(unsigned short n)
+{
+	char buf[FMT_U32_MAX_LEN];
+	for (unsigned short i = 0; i < n; i++)
+	{
+		fmt_u16(buf, 12345);
+	}
+}
+
+static void run_tick_count(unsigned short n)
+{
+	unsigned short t[2];
+	for (unsigned short i = 0; i < n; i++)
+	{
+		timer_get_tick_count(t);
+	}
+}
+
+static void run_rng(unsigned short n)
+{
+	for (unsigned short i = 0; i < n; i++)
+	{
+		rng_rand();
+	}
+}
+
+static void run_fix12_mul(unsigned short n)
+{
+	for (unsigned short i = 0; i < n; i++)
+	{
+		_sink = fix12_mul(-5000, 7000);
+	}
+}
+
+static void run_grep(unsigned short n)
+{
+	if (n == 0)
+	{
+		return;
+	}
+
+	regex_begin_line(_re);
+	for (unsigned char i = 0; i < GREP_TEXT_LEN; i++)
+	{
+		const unsigned char c = _text[i];
+		if (c == '\n')
+		{
+			regex_end_line(_re);
+			regex_begin_line(_re);
+		}
+		else if (c != '\r')
+		{
+			regex_step(_re, c);
+		}
+	}
+}
+
+static void run_ee_read(unsigned short n)
+{
+	for (unsigned short i = 0; i < n; i++)
+	{
+		_sink = ee_read(i);
+	}
+}
+
+static void drop_byte(unsigned char c)
+{
+}
+
+// The name, then the cycles right-aligned (or "-"), then what they are per.
+static void write_row(const char* name, unsigned long cycles, const char* unit)
+{
+	char buf[FMT_U32_MAX_LEN];
+
+	write_padded(name, BENCH_NAME_WIDTH, false);
+
+	if (cycles == BENCH_NONE)
+	{
+		write_padded(PSTR("-"), BENCH_VALUE_WIDTH, true);
+	}
+	else
+	{
+		serial_write(buf, fmt_u32_pad(buf, cycles, BENCH_VALUE_WIDTH, ' '));
+	}
+
+	serial_tx_byte(' ');
+	serial_write_P(unit);
+	serial_write_newline();
+}
+
+static void write_padded(const char* s, unsigned char width, bool right)
+{
+	const unsigned char len = strlen_P(s);
+
+	if (!right)
+	{
+		serial_write_P(s);
+	}
+	for (unsigned char i = len; i < width; i++)
+	{
+		serial_tx_byte(' ');
+	}
+	if (right)
+	{
+		serial_write_P(s);
+	}
+}
@@ -0,0 +1,6 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+void bench_main();
+
+#endif // _BENCH_H_
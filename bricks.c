@@ -1,3 +1,4 @@
+#include <avr/pgmspace.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,6 +7,8 @@
 #include "game.h"
 
 #include "draw.h"
+#include "fix.h"
+#include "render.h"
 #include "rng.h"
 #include "serial.h"
 #include "term.h"
@@ -17,13 +20,17 @@
 #define BRICK_MAP_WIDTH ((BRICKS_WIDTH >> 2) - 2)
 #define BRICK_MAP_HEIGHT (BRICKS_HEIGHT - 6)
 
+#if (BRICK_MAP_WIDTH > 32) || (BRICK_MAP_HEIGHT > 16)
+	#error "Brick map too large for its row masks!"
+#endif
+
 #define WALL_C '#'
 #define PADDLE_C '='
 #define BALL_C '+'
 #define SPACE_C ' '
 #define CLEAR_C SPACE_C
 #define RESUME_C SPACE_C
-#define QUIT_C 'Q'
+#define QUIT_C GAME_QUIT_C
 
 #define P_LEFT_C 'a'
 #define P_RIGHT_C 'd'
@@ -37,6 +44,12 @@
 
 #define BRICKS_GAME_FPS 24
 
+// Glyphs, which are indices into GLYPHS. There are three brick glyphs, one for each color.
+#define CLEAR_G 0
+#define BALL_G 1
+#define PADDLE_G 2
+#define BRICK_G 3
+
 
 typedef struct
 {
@@ -51,18 +64,40 @@ typedef struct
 	short y;
 	short vx;
 	short vy;
+	short x_prev;
+	short y_prev;
 
+	// Brick hit in the last step (in brick map units), to be cleared.
 	bool brick;
+	short brick_x;
+	short brick_y;
 } ball_t;
 
+// One bit per brick, and one bit in rows for each row with any bricks left.
+typedef struct
+{
+	unsigned long row[BRICK_MAP_HEIGHT];
+	unsigned short rows;
+} brick_map_t;
+
+
+static const render_glyph_t GLYPHS[] = {
+	{ CLEAR_C, DRAW_BG_RESET },
+	{ BALL_C, DRAW_BG_RESET },
+	{ PADDLE_C, DRAW_BG_RESET },
+	{ SPACE_C, DRAW_BG_RED },
+	{ SPACE_C, DRAW_BG_GREEN },
+	{ SPACE_C, DRAW_BG_BLUE }
+};
+
 
 static void paddle_left(paddle_t* p);
 static void paddle_right(paddle_t* p);
-static short update_and_check_ball_position(ball_t* b, paddle_t* p, unsigned char* brick_map);
+static short update_and_check_ball_position(ball_t* b, paddle_t* p, brick_map_t* brick_map);
+static short move_ball(ball_t* b, brick_map_t* brick_map);
+static bool hit_brick(ball_t* b, brick_map_t* brick_map, short x, short y);
 static void adjust_ball_angle_for_paddle_pos(ball_t* b, short paddle_pos);
-static void draw_frame(paddle_t* p, ball_t* ball, short score);
-static short ball_c2v(short c);
-static short ball_v2c(short v);
+static void draw_frame(render_t* r, paddle_t* p, ball_t* ball, short score);
 static short brick_map_x_to_tx(short x);
 static short brick_map_y_to_ty(short y);
 static short brick_map_tx_to_x(short tx);
@@ -71,6 +106,10 @@ static short brick_map_ty_to_y(short ty);
 
 void bricks_main()
 {
+	render_t render;
+	game_context_t ctx;
+	game_context_init(&ctx, BRICKS_GAME_FPS, &render, &bricks_main);
+
 	// Init paddle.
 	paddle_t p = { PADDLE_X_INIT, PADDLE_X_INIT };
 
@@ -79,28 +118,20 @@ void bricks_main()
 	const short ball_vy_init = -156;
 
 	// Init ball.
-	ball_t ball = { ball_c2v(PADDLE_X_INIT + (PADDLE_W / 2)), ball_c2v(PADDLE_Y - 1), ball_vx_init, ball_vy_init, false };
+	const short ball_x_init = fix8_from_int(PADDLE_X_INIT + (PADDLE_W / 2));
+	const short ball_y_init = fix8_from_int(PADDLE_Y - 1);
+	ball_t ball = { ball_x_init, ball_y_init, ball_vx_init, ball_vy_init, ball_x_init, ball_y_init, false, 0, 0 };
 
 	// Init score.
 	short score = 0;
 
-	// Init brick map.
-	unsigned char bricks[BRICK_MAP_WIDTH * BRICK_MAP_HEIGHT];
+	// Init brick map, with three rows of bricks.
+	brick_map_t bricks;
 	for (short i = 0; i < BRICK_MAP_HEIGHT; i++)
 	{
-		unsigned char brick_val = 0;
-
-		// Create three rows of bricks.
-		if (i >= 1 && i <= 3)
-		{
-			brick_val = 1;
-		}
-
-		for (short j = 0; j < BRICK_MAP_WIDTH; j++)
-		{
-			bricks[BRICK_MAP_WIDTH * i + j] = brick_val;
-		}
+		bricks.row[i] = ((i >= 1 && i <= 3) ? (0xffffffff >> (32 - BRICK_MAP_WIDTH)) : 0);
 	}
+	bricks.rows = 0x000e;
 
 
 	// Prepare for drawing on screen.
@@ -110,6 +141,10 @@ void bricks_main()
 	// Draw walls.
 	draw_border(BRICKS_WIDTH, BRICKS_HEIGHT, WALL_C);
 
+	// Everything inside the walls is drawn through the renderer.
+	unsigned char shadow[RENDER_SHADOW_SIZE(BRICKS_WIDTH - 2, BRICKS_HEIGHT - 2)];
+	render_init(&render, shadow, 2, 2, BRICKS_WIDTH - 2, BRICKS_HEIGHT - 2, GLYPHS);
+
 	// Draw bricks from map.
 	for (short i = 0; i < BRICK_MAP_HEIGHT; i++)
 	{
@@ -117,28 +152,26 @@ void bricks_main()
 
 		for (short j = 0; j < BRICK_MAP_WIDTH; j++)
 		{
-			if (bricks[BRICK_MAP_WIDTH * i + j] == 0)
+			if ((bricks.row[i] & (1UL << j)) == 0)
 			{
 				continue;
 			}
 
 			const short x = brick_map_x_to_tx(j);
-			draw_horizontal_bg(x, y, 4, (y % 3) + 1);
+			render_put_horizontal(&render, x, y, 4, BRICK_G + (y % 3));
 		}
 	}
 
 	// Draw paddle.
-	draw_horizontal(p.x, PADDLE_Y, PADDLE_W, PADDLE_C);
+	render_put_horizontal(&render, p.x, PADDLE_Y, PADDLE_W, PADDLE_G);
 
 	// Draw ball.
-	draw_horizontal(ball_v2c(ball.x), ball_v2c(ball.y), 1, BALL_C);
+	render_put(&render, fix8_to_int(ball.x), fix8_to_int(ball.y), BALL_G);
 
+	render_frame(&render);
 	term_cursor_home();
 
 
-	game_context_t ctx;
-	game_context_init(&ctx, BRICKS_GAME_FPS);
-
 	unsigned char c = game_get_char(&ctx, true);
 	short check = 0;
 	while (1)
@@ -156,15 +189,16 @@ void bricks_main()
 			paddle_right(&p);
 		}
 
-		if (game_should_draw_frame(&ctx))
+		if (game_should_step(&ctx))
 		{
-			check = update_and_check_ball_position(&ball, &p, bricks);
+			check = update_and_check_ball_position(&ball, &p, &bricks);
 			if (check != 0)
 			{
 				score += check;
 			}
 
-			draw_frame(&p, &ball, check == 0 ? 0 : score);
+			draw_frame(&render, &p, &ball, check == 0 ? 0 : score);
+			game_draw(&ctx);
 		}
 
 		do {
@@ -174,19 +208,22 @@ void bricks_main()
 		if (check < 0)
 		{
 			// Move ball to paddle.
-			draw_horizontal(ball_v2c(ball.x), ball_v2c(ball.y), 1, CLEAR_C);
+			render_put(&render, fix8_to_int(ball.x), fix8_to_int(ball.y), CLEAR_G);
 
-			ball.x = ball_c2v(p.x + (PADDLE_W / 2));
-			ball.y = ball_c2v(PADDLE_Y - 1);
+			ball.x = fix8_from_int(p.x + (PADDLE_W / 2));
+			ball.y = fix8_from_int(PADDLE_Y - 1);
 			ball.vx = ball_vx_init;
 			ball.vy = ball_vy_init;
 
-			draw_horizontal(ball_v2c(ball.x), ball_v2c(ball.y), 1, BALL_C);
+			render_put(&render, fix8_to_int(ball.x), fix8_to_int(ball.y), BALL_G);
+			render_frame(&render);
 		}
 	}
 
 	term_clear_screen();
 	term_set_cursor(true);
+
+	game_context_end(&ctx);
 }
 
 
@@ -210,60 +247,165 @@ static void paddle_right(paddle_t* p)
 	p->x++;
 }
 
-static short update_and_check_ball_position(ball_t* b, paddle_t* p, unsigned char* brick_map)
+static short update_and_check_ball_position(ball_t* b, paddle_t* p, brick_map_t* brick_map)
 {
-	short check = 0;
+	b->x_prev = b->x;
+	b->y_prev = b->y;
 
-	short ball_x = ball_v2c(b->x);
-	short ball_y = ball_v2c(b->y);
+	short ball_x = fix8_to_int(b->x);
+	short ball_y = fix8_to_int(b->y);
 
-	// Bounce off sides?
-	if ((b->vx > 0 && ball_x >= BRICKS_WIDTH - 1) || ((b->vx < 0 && ball_x <= 2)))
+	// Bounce off paddle (or miss it)?
+	if (b->vy > 0 && ball_y >= PADDLE_Y)
 	{
-		b->vx = -b->vx;
+		if (ball_x < p->x || ball_x > p->x + PADDLE_W)
+		{
+			// Ball missed paddle, and is moved back to it before going on.
+			return -25;
+		}
+		else
+		{
+			// Ball on paddle.
+			short paddle_pos = ball_x - p->x;
+			adjust_ball_angle_for_paddle_pos(b, paddle_pos);
+		}
+
+		b->vy = -b->vy;
 	}
 
-	// Bounce off top/bottom?
-	if ((b->vy > 0 && ball_y >= BRICKS_HEIGHT - 1) || ((b->vy < 0 && ball_y <= 2)))
+	return move_ball(b, brick_map);
+}
+
+// Moves the ball along its path for one step, one cell crossing at a time, so
+// that nothing is passed through however fast it goes. On reaching a wall or a
+// brick, the ball stops at the edge of the cell it is in for the rest of the
+// step, and bounces off the side it reached.
+static short move_ball(ball_t* b, brick_map_t* brick_map)
+{
+	const short sx = (b->vx < 0 ? -1 : 1);
+	const short sy = (b->vy < 0 ? -1 : 1);
+	const unsigned short ax = (b->vx < 0 ? -b->vx : b->vx);
+	const unsigned short ay = (b->vy < 0 ? -b->vy : b->vy);
+
+	// What is left of the step on each axis.
+	unsigned short rx = ax;
+	unsigned short ry = ay;
+
+	while (true)
 	{
-		if (ball_y == PADDLE_Y)
+		// Distances to the next cell on each axis.
+		const unsigned short dx = (sx > 0 ? FIX8_ONE - (b->x & 0xff) : (b->x & 0xff) + 1);
+		const unsigned short dy = (sy > 0 ? FIX8_ONE - (b->y & 0xff) : (b->y & 0xff) + 1);
+
+		bool on_x = (dx <= rx);
+		const bool on_y = (dy <= ry);
+
+		if (!on_x && !on_y)
+		{
+			b->x += sx * (short)rx;
+			b->y += sy * (short)ry;
+			return 0;
+		}
+		else if (on_x && on_y)
 		{
-			// Ball at paddle level.
-			if (ball_x < p->x || ball_x > p->x + PADDLE_W)
+			// Whichever is crossed first.
+			on_x = ((unsigned long)dx * ay <= (unsigned long)dy * ax);
+		}
+
+		// Movement up to the crossing, on each axis.
+		unsigned short mx;
+		unsigned short my;
+		if (on_x)
+		{
+			mx = dx;
+			my = (unsigned long)dx * ay / ax;
+			my = (my >= dy ? dy - 1 : (my > ry ? ry : my));
+		}
+		else
+		{
+			my = dy;
+			mx = (unsigned long)dy * ax / ay;
+			mx = (mx >= dx ? dx - 1 : (mx > rx ? rx : mx));
+		}
+
+		const short x = fix8_to_int(b->x + sx * (short)mx);
+		const short y = fix8_to_int(b->y + sy * (short)my);
+
+		short check = 0;
+		bool bounce;
+		if (y > PADDLE_Y)
+		{
+			// The paddle is only checked at the start of a step, so stay above it until then.
+			b->x += sx * (short)mx;
+			b->y = fix8_from_int(PADDLE_Y + 1) - 1;
+			return 0;
+		}
+		else if (x < 2 || x > BRICKS_WIDTH - 1 || y < 2)
+		{
+			bounce = true;
+		}
+		else if (hit_brick(b, brick_map, x, y))
+		{
+			bounce = true;
+			check = 10;
+		}
+		else
+		{
+			bounce = false;
+		}
+
+		if (bounce)
+		{
+			// Stop short of the crossing.
+			if (on_x)
 			{
-				// Ball missed paddle.
-				check = -25;
+				b->x += sx * (short)(mx - 1);
+				b->y += sy * (short)my;
+				b->vx = -b->vx;
 			}
 			else
 			{
-				// Ball on paddle.
-				short paddle_pos = ball_x - p->x;
-				adjust_ball_angle_for_paddle_pos(b, paddle_pos);
+				b->x += sx * (short)mx;
+				b->y += sy * (short)(my - 1);
+				b->vy = -b->vy;
 			}
+
+			return check;
 		}
 
-		b->vy = -b->vy;
+		b->x += sx * (short)mx;
+		b->y += sy * (short)my;
+		rx -= mx;
+		ry -= my;
 	}
+}
 
-	// Bounce of wall?
-	const short mx = brick_map_tx_to_x(ball_x);
-	const short my = brick_map_ty_to_y(ball_y);
-	if (mx >= 0 && my >= 0 && mx < BRICK_MAP_WIDTH && my < BRICK_MAP_HEIGHT)
+static bool hit_brick(ball_t* b, brick_map_t* brick_map, short x, short y)
+{
+	const short my = brick_map_ty_to_y(y);
+	if (my < 0 || my >= BRICK_MAP_HEIGHT || (brick_map->rows & (1 << my)) == 0 || x < brick_map_x_to_tx(0))
 	{
-		const short bricks_i = my * BRICK_MAP_WIDTH + mx;
-		if (brick_map[bricks_i] != 0)
-		{
-			b->vy = -b->vy; // TODO: What if ball hit brick from the side?
-			brick_map[bricks_i] = 0;
-			b->brick = true;
-			check = 10;
-		}
+		return false;
+	}
+
+	const short mx = brick_map_tx_to_x(x);
+	const unsigned long bit = (1UL << mx);
+	if (mx >= BRICK_MAP_WIDTH || (brick_map->row[my] & bit) == 0)
+	{
+		return false;
 	}
 
-	b->x += b->vx;
-	b->y += b->vy;
+	brick_map->row[my] &= ~bit;
+	if (brick_map->row[my] == 0)
+	{
+		brick_map->rows &= ~(1 << my);
+	}
+
+	b->brick = true;
+	b->brick_x = mx;
+	b->brick_y = my;
 
-	return check;
+	return true;
 }
 
 static void adjust_ball_angle_for_paddle_pos(ball_t* b, short paddle_pos)
@@ -303,65 +445,54 @@ static void adjust_ball_angle_for_paddle_pos(ball_t* b, short paddle_pos)
 	}
 }
 
-static void draw_frame(paddle_t* p, ball_t* ball, short score)
+static void draw_frame(render_t* r, paddle_t* p, ball_t* ball, short score)
 {
 	// Redraw paddle, if necessary.
 	if (p->x_prev != p->x)
 	{
-		draw_horizontal(p->x_prev, PADDLE_Y, PADDLE_W, CLEAR_C);
-		draw_horizontal(p->x, PADDLE_Y, PADDLE_W, PADDLE_C);
+		render_put_horizontal(r, p->x_prev, PADDLE_Y, PADDLE_W, CLEAR_G);
+		render_put_horizontal(r, p->x, PADDLE_Y, PADDLE_W, PADDLE_G);
 		p->x_prev = p->x;
 	}
 
-	short ball_prev_x = ball_v2c(ball->x - ball->vx);
-	short ball_prev_y = ball_v2c(ball->y - ball->vy);
+	short ball_prev_x = fix8_to_int(ball->x_prev);
+	short ball_prev_y = fix8_to_int(ball->y_prev);
 
 	// Determine what is at the ball's previous position.
-	char ball_prev_c;
+	unsigned char ball_prev_g;
 	if (((ball_prev_y == PADDLE_Y) &&
 		(ball_prev_x >= p->x) &&
 		(ball_prev_x < p->x + PADDLE_W)))
 	{
 		// Previous ball position is on paddle.
-		ball_prev_c = PADDLE_C;
+		ball_prev_g = PADDLE_G;
 	}
 	else
 	{
-		if (ball->brick)
-		{
-			// Clear brick at previous ball position.
-			draw_horizontal_bg(brick_map_x_to_tx(brick_map_tx_to_x(ball_prev_x)), ball_prev_y, 4, DRAW_BG_RESET);
-			ball->brick = false;
-		}
-
 		// Previous ball position is empty space.
-		ball_prev_c = CLEAR_C;
+		ball_prev_g = CLEAR_G;
+	}
+
+	if (ball->brick)
+	{
+		render_put_horizontal(r, brick_map_x_to_tx(ball->brick_x), brick_map_y_to_ty(ball->brick_y), 4, CLEAR_G);
+		ball->brick = false;
 	}
 
 	// Draw new ball position.
-	draw_horizontal(ball_prev_x, ball_prev_y, 1, ball_prev_c);
-	draw_horizontal(ball_v2c(ball->x), ball_v2c(ball->y), 1, BALL_C);
+	render_put(r, ball_prev_x, ball_prev_y, ball_prev_g);
+	render_put(r, fix8_to_int(ball->x), fix8_to_int(ball->y), BALL_G);
 
 	// Print score, if necessary.
 	if (score)
 	{
 		char buf[10];
 		term_move_cursor(SCORE_POS_X, SCORE_POS_Y);
-		sprintf(buf, "%d   ", score);
+		sprintf_P(buf, PSTR("%d   "), score);
 		serial_write(buf, strlen(buf));
 	}
 }
 
-static short ball_c2v(short c)
-{
-	return (c << 8);
-}
-
-static short ball_v2c(short v)
-{
-	return (v >> 8);
-}
-
 static short brick_map_x_to_tx(short x)
 {
 	return ((x << 2) + 5);
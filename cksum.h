@@ -0,0 +1,6 @@
+#ifndef _CKSUM_H_
+#define _CKSUM_H_
+
+void cksum_main(void* arg);
+
+#endif // _CKSUM_H_
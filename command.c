@@ -1,62 +1,114 @@
+#include <avr/pgmspace.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "command.h"
 
+#include "bench.h"
 #include "bricks.h"
+#include "cksum.h"
+#include "cut.h"
 #include "dump.h"
+#include "eefs.h"
+#include "fmt.h"
+#include "game.h"
 #include "grep.h"
+#include "head.h"
+#include "history.h"
 #include "led.h"
+#include "life.h"
+#include "logger.h"
+#include "lz.h"
+#include "machine.h"
+#include "mandel.h"
+#include "mem.h"
 #include "pm.h"
 #include "pong.h"
+#include "rbuf.h"
 #include "rng.h"
+#include "script.h"
 #include "seq.h"
 #include "serial.h"
 #include "serial_proxy.h"
 #include "snake.h"
 #include "sp_mon.h"
+#include "tail.h"
 #include "term.h"
 #include "thermal.h"
 #include "thread.h"
 #include "time.h"
 #include "timer.h"
+#include "tr.h"
+#include "uniq.h"
 #include "util.h"
+#include "watch.h"
 #include "wc.h"
+#include "xxd.h"
 
 #include "avr_mcu.h"
 
-#define HELP_LINE_MAX_LENGTH 48
-
 #define PC_PT_EXEC (0)
 #define PC_PT_ALLOW_FIRST (1)
 #define PC_PT_ALLOW_SECOND (2)
 
-static const char* CMD_HELP = "help";
-static const char* CMD_RESET = "reset";
-static const char* CMD_STOP = "stop";
-static const char* CMD_DUMP = "dump";
-static const char* CMD_LED_ON = "led_on";
-static const char* CMD_LED_OFF = "led_off";
-static const char* CMD_SYS_INFO = "sysinfo";
-static const char* CMD_TIME = "time";
-static const char* CMD_SET_TIME = "settime";
-static const char* CMD_CLEAR = "clear";
-static const char* CMD_SLEEP = "sleep";
-static const char* CMD_RAND = "rand";
-static const char* CMD_SP_MON_ON = "spm_on";
-static const char* CMD_SP_MON_OFF = "spm_off";
-static const char* CMD_SP_MON_INFO = "spm_info";
-static const char* CMD_PONG = "pong";
-static const char* CMD_SNAKE = "snake";
-static const char* CMD_BRICKS = "bricks";
-static const char* CMD_GREP = "grep";
-static const char* CMD_SEQ = "seq";
-static const char* CMD_WC = "wc";
+static const char CMD_HELP[] PROGMEM = "help";
+static const char CMD_HISTORY[] PROGMEM = "history";
+static const char CMD_RESET[] PROGMEM = "reset";
+static const char CMD_STOP[] PROGMEM = "stop";
+static const char CMD_DUMP[] PROGMEM = "dump";
+static const char CMD_HEXDUMP[] PROGMEM = "hexdump";
+static const char CMD_PEEK[] PROGMEM = "peek";
+static const char CMD_POKE[] PROGMEM = "poke";
+static const char CMD_LED_ON[] PROGMEM = "led_on";
+static const char CMD_LED_OFF[] PROGMEM = "led_off";
+static const char CMD_SYS_INFO[] PROGMEM = "sysinfo";
+static const char CMD_BENCH[] PROGMEM = "bench";
+static const char CMD_TIME[] PROGMEM = "time";
+static const char CMD_SET_TIME[] PROGMEM = "settime";
+static const char CMD_CLEAR[] PROGMEM = "clear";
+static const char CMD_SLEEP[] PROGMEM = "sleep";
+static const char CMD_RAND[] PROGMEM = "rand";
+static const char CMD_SP_MON_ON[] PROGMEM = "spm_on";
+static const char CMD_SP_MON_OFF[] PROGMEM = "spm_off";
+static const char CMD_SP_MON_INFO[] PROGMEM = "spm_info";
+static const char CMD_PONG[] PROGMEM = "pong";
+static const char CMD_SNAKE[] PROGMEM = "snake";
+static const char CMD_BRICKS[] PROGMEM = "bricks";
+static const char CMD_LIFE[] PROGMEM = "life";
+static const char CMD_MANDEL[] PROGMEM = "mandel";
+static const char CMD_GAMESTAT[] PROGMEM = "gamestat";
+static const char CMD_REPLAY[] PROGMEM = "replay";
+static const char CMD_GREP[] PROGMEM = "grep";
+static const char CMD_SEQ[] PROGMEM = "seq";
+static const char CMD_WC[] PROGMEM = "wc";
+static const char CMD_HEAD[] PROGMEM = "head";
+static const char CMD_TAIL[] PROGMEM = "tail";
+static const char CMD_TR[] PROGMEM = "tr";
+static const char CMD_UNIQ[] PROGMEM = "uniq";
+static const char CMD_CUT[] PROGMEM = "cut";
+static const char CMD_XXD[] PROGMEM = "xxd";
+static const char CMD_CKSUM[] PROGMEM = "cksum";
+static const char CMD_SCRIPT[] PROGMEM = "script";
+static const char CMD_ALIAS[] PROGMEM = "alias";
+static const char CMD_WATCH[] PROGMEM = "watch";
+static const char CMD_CAT[] PROGMEM = "cat";
+static const char CMD_BUF[] PROGMEM = "buf";
+static const char CMD_LS[] PROGMEM = "ls";
+static const char CMD_WRITE[] PROGMEM = "write";
+static const char CMD_RM[] PROGMEM = "rm";
+static const char CMD_DF[] PROGMEM = "df";
+static const char CMD_LOG[] PROGMEM = "log";
+static const char CMD_MACHINE[] PROGMEM = "machine";
+static const char CMD_LZ[] PROGMEM = "lz";
 #ifdef SERIAL_EXTRA_SUPPORT
-static const char* CMD_SERIAL_PROXY = "sp";
+static const char CMD_SERIAL_PROXY[] PROGMEM = "sp";
 #endif
 
+static char process_redirect(unsigned char* cmd_str);
+static bool is_redirect_word(const unsigned char* cmd_str, const unsigned char* p, unsigned char len);
+static void end_redirect_read(bool from_file);
+static unsigned char* trim(unsigned char* str);
 static char command_process_internal(unsigned char* cmd_str, char process_type);
 static unsigned char* is_pipe_cmd(unsigned char* cmd_str);
 static char process_second_command(unsigned char* cmd_str);
@@ -70,34 +122,66 @@ static void help_print_f2(const char* cmd, const char* cmd_help);
 static void help_print_f2a(const char* cmd, const char* cmd_help);
 static void pc_led(bool set);
 static void pc_sys_info();
+static void sys_info_write(const char* s);
 static void pc_time();
 static void pc_settime(const char* cmd_str);
 static void pc_clear();
 static void pc_sleep(const char* cmd_str);
 static void pc_rand();
+static void pc_history();
+static void pc_cat(const char* cmd_str);
 static void pc_sp_mon_enable(bool enable);
 static void pc_sp_mon_info();
 
 
 char command_process(unsigned char* cmd_str)
 {
-	return command_process_internal(cmd_str, PC_PT_EXEC);
+	unsigned char buf[SCRIPT_LINE_MAX];
+	if (script_expand_alias(cmd_str, buf, SCRIPT_LINE_MAX))
+	{
+		return process_redirect(buf);
+	}
+
+	return process_redirect(cmd_str);
 }
 
+// Returns the name of the one command starting with cmd, which is kept in flash.
 const char* command_tab_complete(const char* cmd, unsigned short cmd_len, unsigned short* match_count)
 {
-	// All commands, ordered alphabetically
-	const char* CMDS[] = {
+	// All commands, ordered alphabetically (the table and the names are both in flash)
+	static const char* const CMDS[] PROGMEM = {
+		CMD_ALIAS,
+		CMD_BENCH,
 		CMD_BRICKS,
+		CMD_BUF,
+		CMD_CAT,
+		CMD_CKSUM,
 		CMD_CLEAR,
+		CMD_CUT,
+		CMD_DF,
 		CMD_DUMP,
+		CMD_GAMESTAT,
 		CMD_GREP,
+		CMD_HEAD,
 		CMD_HELP,
+		CMD_HEXDUMP,
+		CMD_HISTORY,
 		CMD_LED_OFF,
 		CMD_LED_ON,
+		CMD_LIFE,
+		CMD_LOG,
+		CMD_LS,
+		CMD_LZ,
+		CMD_MACHINE,
+		CMD_MANDEL,
+		CMD_PEEK,
+		CMD_POKE,
 		CMD_PONG,
 		CMD_RAND,
+		CMD_REPLAY,
 		CMD_RESET,
+		CMD_RM,
+		CMD_SCRIPT,
 		CMD_SEQ,
 		CMD_SET_TIME,
 		CMD_SLEEP,
@@ -110,8 +194,14 @@ const char* command_tab_complete(const char* cmd, unsigned short cmd_len, unsign
 		CMD_SP_MON_ON,
 		CMD_STOP,
 		CMD_SYS_INFO,
+		CMD_TAIL,
 		CMD_TIME,
-		CMD_WC
+		CMD_TR,
+		CMD_UNIQ,
+		CMD_WATCH,
+		CMD_WC,
+		CMD_WRITE,
+		CMD_XXD
 	};
 
 	const char* last_match = 0;
@@ -120,14 +210,16 @@ const char* command_tab_complete(const char* cmd, unsigned short cmd_len, unsign
 
 	for (short i = 0; i < cmd_num; i++)
 	{
-		if (strncmp(cmd, CMDS[i], cmd_len) == 0)
+		const char* name = (const char*)pgm_read_word(&CMDS[i]);
+
+		if (strncmp_P(cmd, name, cmd_len) == 0)
 		{
 			matches++;
 
 			if (matches == 2)
 			{
 				serial_write_newline();
-				serial_write(last_match, strlen(last_match));
+				serial_write_P(last_match);
 			}
 
 			if (matches >= 2)
@@ -135,10 +227,10 @@ const char* command_tab_complete(const char* cmd, unsigned short cmd_len, unsign
 				serial_tx_byte(' ');
 				serial_tx_byte(' ');
 				serial_tx_byte(' ');
-				serial_write(CMDS[i], strlen(CMDS[i]));
+				serial_write_P(name);
 			}
 
-			last_match = CMDS[i];
+			last_match = name;
 		}
 	}
 
@@ -147,6 +239,146 @@ const char* command_tab_complete(const char* cmd, unsigned short cmd_len, unsign
 }
 
 
+// Handles "CMD < IN" and "CMD > OUT" redirection from/to named RAM buffers,
+// and "CMD >> F" appending to an EEPROM file. Input is read from the RAM buffer
+// of that name if there is one, or from the EEPROM file otherwise.
+//
+// Only a "<", ">" or ">>" standing as a word of its own is a redirection, so
+// that these chars can still be given in args (as in "grep -E a>b"). A pipe
+// can't be redirected, as the two commands would share the one buffer.
+static char process_redirect(unsigned char* cmd_str)
+{
+	unsigned char* in = 0;
+	unsigned char* out = 0;
+	bool append = false;
+	bool pipe = false;
+
+	for (unsigned char* p = cmd_str; *p != 0x00; p++)
+	{
+		if (*p == '|')
+		{
+			pipe = true;
+		}
+		else if (*p == '<' && is_redirect_word(cmd_str, p, 1))
+		{
+			in = p + 1;
+			*p = 0x00;
+		}
+		else if (*p == '>' && p[1] == '>' && is_redirect_word(cmd_str, p, 2))
+		{
+			append = true;
+			*p++ = 0x00;
+			out = p + 1;
+			*p = 0x00;
+		}
+		else if (*p == '>' && is_redirect_word(cmd_str, p, 1))
+		{
+			append = false;
+			out = p + 1;
+			*p = 0x00;
+		}
+	}
+
+	if (in == 0 && out == 0)
+	{
+		return command_process_internal(cmd_str, PC_PT_EXEC);
+	}
+
+	if (pipe)
+	{
+		serial_write_P(PSTR("invalid"));
+		serial_write_newline();
+
+		return 0;
+	}
+
+	cmd_str = trim(cmd_str);
+
+	bool in_file = false;
+	if (in != 0)
+	{
+		in = trim(in);
+		if (!rbuf_start_read(in))
+		{
+			in_file = eefs_start_read(in);
+			if (!in_file)
+			{
+				serial_write_P(PSTR("bad input"));
+				serial_write_newline();
+
+				return 0;
+			}
+		}
+	}
+
+	if (out != 0 && !(append ? eefs_start_append(trim(out)) : rbuf_start_write(trim(out))))
+	{
+		if (in != 0)
+		{
+			end_redirect_read(in_file);
+		}
+
+		serial_write_P(PSTR("bad output"));
+		serial_write_newline();
+
+		return 0;
+	}
+
+	char rc = command_process_internal(cmd_str, PC_PT_EXEC);
+
+	if (out != 0 && append && !eefs_end_append())
+	{
+		serial_write_P(PSTR("no space"));
+		serial_write_newline();
+	}
+	else if (out != 0 && !append && !rbuf_end_write())
+	{
+		serial_write_P(PSTR("truncated"));
+		serial_write_newline();
+	}
+
+	if (in != 0)
+	{
+		end_redirect_read(in_file);
+	}
+
+	return rc;
+}
+
+// The len chars at p must have a space (or the start of the line) before them, and a space after.
+static bool is_redirect_word(const unsigned char* cmd_str, const unsigned char* p, unsigned char len)
+{
+	return ((p == cmd_str || p[-1] == ' ') && p[len] == ' ');
+}
+
+static void end_redirect_read(bool from_file)
+{
+	if (from_file)
+	{
+		eefs_end_read();
+	}
+	else
+	{
+		rbuf_end_read();
+	}
+}
+
+static unsigned char* trim(unsigned char* str)
+{
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	short i = strlen(str);
+	while (i > 0 && str[i - 1] == ' ')
+	{
+		str[--i] = 0x00;
+	}
+
+	return str;
+}
+
 static char command_process_internal(unsigned char* cmd_str, char process_type)
 {
 	if (strlen(cmd_str) == 0)
@@ -159,11 +391,14 @@ static char command_process_internal(unsigned char* cmd_str, char process_type)
 		unsigned char* cmd_str_2 = is_pipe_cmd(cmd_str);
 		if (cmd_str_2 != 0)
 		{
+			// The first command ends at the pipe, so that it doesn't take the
+			// second one as more of its arguments.
+			cmd_str_2[-1] = 0x00;
+			cmd_str = trim(cmd_str);
+
 			if (command_process_internal(cmd_str, PC_PT_ALLOW_FIRST) != 0 || process_second_command(cmd_str_2) != 0)
 			{
-				char buf[8];
-				sprintf(buf, "invalid");
-				serial_write(buf, strlen(buf));
+				serial_write_P(PSTR("invalid"));
 				serial_write_newline();
 
 				return 0;
@@ -190,6 +425,43 @@ static char command_process_internal(unsigned char* cmd_str, char process_type)
 			return -1;
 		}
 	}
+	else if (begins_with_cmd(cmd_str, CMD_HEXDUMP))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			mem_hexdump(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_PEEK))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			mem_peek(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_POKE))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			mem_poke(cmd_str);
+		}
+		else
+		{
+			return -1;
+		}
+	}
 	else if (begins_with_cmd(cmd_str, CMD_HELP))
 	{
 		switch (process_type)
@@ -203,6 +475,19 @@ static char command_process_internal(unsigned char* cmd_str, char process_type)
 			return -1;
 		}
 	}
+	else if (begins_with_cmd(cmd_str, CMD_HISTORY))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			pc_history();
+			break;
+		case PC_PT_ALLOW_FIRST:
+			return 0;
+		default:
+			return -1;
+		}
+	}
 	else if (begins_with_cmd(cmd_str, CMD_LED_ON))
 	{
 		if (process_type == PC_PT_EXEC)
@@ -238,6 +523,17 @@ static char command_process_internal(unsigned char* cmd_str, char process_type)
 			return -1;
 		}
 	}
+	else if (begins_with_cmd(cmd_str, CMD_BENCH))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			bench_main();
+		}
+		else
+		{
+			return -1;
+		}
+	}
 	else if (begins_with_cmd(cmd_str, CMD_TIME))
 	{
 		switch (process_type)
@@ -367,6 +663,54 @@ static char command_process_internal(unsigned char* cmd_str, char process_type)
 			return -1;
 		}
 	}
+	else if (begins_with_cmd(cmd_str, CMD_LIFE))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			life_main(cmd_str);
+		}
+		else
+		{
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_MANDEL))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			mandel_main(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_GAMESTAT))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			game_stat_main();
+			break;
+		case PC_PT_ALLOW_FIRST:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_REPLAY))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			game_replay_main();
+		}
+		else
+		{
+			return -1;
+		}
+	}
 	else if (begins_with_cmd(cmd_str, CMD_GREP))
 	{
 		switch (process_type)
@@ -408,6 +752,253 @@ static char command_process_internal(unsigned char* cmd_str, char process_type)
 			return -1;
 		}
 	}
+	else if (begins_with_cmd(cmd_str, CMD_HEAD))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			head_main(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+		case PC_PT_ALLOW_SECOND:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_TAIL))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			tail_main(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+		case PC_PT_ALLOW_SECOND:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_TR))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			tr_main(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+		case PC_PT_ALLOW_SECOND:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_UNIQ))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			uniq_main(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+		case PC_PT_ALLOW_SECOND:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_CUT))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			cut_main(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+		case PC_PT_ALLOW_SECOND:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_XXD))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			xxd_main(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+		case PC_PT_ALLOW_SECOND:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_CKSUM))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			cksum_main(cmd_str);
+			break;
+		case PC_PT_ALLOW_SECOND:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_CAT))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			pc_cat(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_BUF))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			rbuf_main(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_LZ))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			lz_main(cmd_str);
+		}
+		else
+		{
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_MACHINE))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			char rc = machine_main();
+			if (rc < 0)
+			{
+				return rc;
+			}
+		}
+		else
+		{
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_LOG))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			logger_main(cmd_str);
+			break;
+		case PC_PT_ALLOW_FIRST:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_LS))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			eefs_ls();
+			break;
+		case PC_PT_ALLOW_FIRST:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_DF))
+	{
+		switch (process_type)
+		{
+		case PC_PT_EXEC:
+			eefs_df();
+			break;
+		case PC_PT_ALLOW_FIRST:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_WRITE))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			eefs_write_main(cmd_str);
+		}
+		else
+		{
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_RM))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			eefs_rm_main(cmd_str);
+		}
+		else
+		{
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_WATCH))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			watch_main(cmd_str);
+		}
+		else
+		{
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_SCRIPT))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			char rc = script_main(cmd_str);
+			if (rc < 0)
+			{
+				return rc;
+			}
+		}
+		else
+		{
+			return -1;
+		}
+	}
+	else if (begins_with_cmd(cmd_str, CMD_ALIAS))
+	{
+		if (process_type == PC_PT_EXEC)
+		{
+			script_alias_main(cmd_str);
+		}
+		else
+		{
+			return -1;
+		}
+	}
 #ifdef SERIAL_EXTRA_SUPPORT
 	else if (begins_with_cmd(cmd_str, CMD_SERIAL_PROXY))
 	{
@@ -429,7 +1020,7 @@ static char command_process_internal(unsigned char* cmd_str, char process_type)
 		}
 
 		char buf[20];
-		sprintf(buf, "?: Try \'%s\'.", CMD_HELP);
+		sprintf_P(buf, PSTR("?: Try \'%S\'."), CMD_HELP);
 		serial_write(buf, strlen(buf));
 		serial_write_newline();
 	}
@@ -499,88 +1090,161 @@ static void* get_entry_for_second(const unsigned char* cmd_str)
 	{
 		return &wc_main;
 	}
+	else if (begins_with_cmd(cmd_str, CMD_HEAD))
+	{
+		return &head_main;
+	}
+	else if (begins_with_cmd(cmd_str, CMD_TAIL))
+	{
+		return &tail_main;
+	}
+	else if (begins_with_cmd(cmd_str, CMD_TR))
+	{
+		return &tr_main;
+	}
+	else if (begins_with_cmd(cmd_str, CMD_UNIQ))
+	{
+		return &uniq_main;
+	}
+	else if (begins_with_cmd(cmd_str, CMD_CUT))
+	{
+		return &cut_main;
+	}
+	else if (begins_with_cmd(cmd_str, CMD_XXD))
+	{
+		return &xxd_main;
+	}
+	else if (begins_with_cmd(cmd_str, CMD_CKSUM))
+	{
+		return &cksum_main;
+	}
 
 	return 0;
 }
 
 static bool begins_with_cmd(const char* str, const char* cmd)
 {
-	const unsigned short cmd_len = strlen(cmd);
+	const unsigned short cmd_len = strlen_P(cmd);
 
-	return (strncmp(str, cmd, cmd_len) == 0 && (str[cmd_len] == 0x00 || str[cmd_len] == ' ' || str[cmd_len] == '|'));
+	return (strncmp_P(str, cmd, cmd_len) == 0 && (str[cmd_len] == 0x00 || str[cmd_len] == ' ' || str[cmd_len] == '|'));
 }
 
 static void pc_help()
 {
 	// General
-	help_print_f0("General:");
+	help_print_f0(PSTR("General:"));
 	help_print_f1(CMD_HELP);
-	help_print_f2(CMD_SYS_INFO, "show system info");
-	help_print_f2(CMD_CLEAR, "clear screen");
-	help_print_f2a(CMD_SLEEP, "N: sleep N seconds");
-	help_print_f2(CMD_RAND, "get random number");
+	help_print_f2(CMD_SYS_INFO, PSTR("show system info"));
+	help_print_f2(CMD_BENCH, PSTR("cycles per op of core paths"));
+	help_print_f2(CMD_CLEAR, PSTR("clear screen"));
+	help_print_f2a(CMD_SLEEP, PSTR("N: sleep N seconds"));
+	help_print_f2(CMD_RAND, PSTR("get random number"));
+	help_print_f2(CMD_HISTORY, PSTR("list commands (!N, !! to rerun)"));
 	help_print_f1(CMD_LED_ON);
 	help_print_f1(CMD_LED_OFF);
+	help_print_f2(CMD_MACHINE, PSTR("framed mode for hosts"));
+	help_print_f2a(CMD_LZ, PSTR("[on|off]: compressed output"));
 	help_print_f1(CMD_RESET);
 	help_print_f1(CMD_STOP);
 
 	// Time
-	help_print_f0("Time:");
+	help_print_f0(PSTR("Time:"));
 	help_print_f1(CMD_TIME);
-	help_print_f2a(CMD_SET_TIME, "HH:MM:SS");
+	help_print_f2a(CMD_SET_TIME, PSTR("HH:MM:SS"));
 
 	// Stack Pointer Monitor
-	help_print_f0("SP Monitor:");
-	help_print_f2(CMD_SP_MON_ON, "start");
-	help_print_f2(CMD_SP_MON_OFF, "stop");
-	help_print_f2(CMD_SP_MON_INFO, "show results");
+	help_print_f0(PSTR("SP Monitor:"));
+	help_print_f2(CMD_SP_MON_ON, PSTR("start"));
+	help_print_f2(CMD_SP_MON_OFF, PSTR("stop"));
+	help_print_f2(CMD_SP_MON_INFO, PSTR("show results"));
+
+	// Logger
+	help_print_f0(PSTR("Logger:"));
+	help_print_f2(CMD_LOG, PSTR("show status"));
+	help_print_f2a(CMD_LOG, PSTR("on [N]|off|dump|clear"));
+
+	// Memory
+	help_print_f0(PSTR("Memory (ADDR/N: decimal or 0x hex):"));
+	help_print_f2a(CMD_HEXDUMP, PSTR("[-f|-e] ADDR [N]"));
+	help_print_f2a(CMD_PEEK, PSTR("ADDR"));
+	help_print_f2a(CMD_POKE, PSTR("ADDR V"));
 
 	// Games
-	help_print_f0("Games:");
+	help_print_f0(PSTR("Games:"));
 	help_print_f1(CMD_PONG);
 	help_print_f1(CMD_SNAKE);
 	help_print_f1(CMD_BRICKS);
+	help_print_f2a(CMD_LIFE, PSTR("[-q] [N]: gens/s, -q no drawing"));
+	help_print_f2a(CMD_MANDEL, PSTR("[-q] [N]: iters/s, N max iters"));
+	help_print_f2(CMD_GAMESTAT, PSTR("frame rate of last game"));
+	help_print_f2(CMD_REPLAY, PSTR("rerun last game headless, timed"));
 
 	// Utils
-	help_print_f0("Utils:");
-	help_print_f2a(CMD_GREP, "S");
-	help_print_f2a(CMD_SEQ, "X Y");
-	help_print_f1(CMD_WC);
+	help_print_f0(PSTR("Utils:"));
+	help_print_f2a(CMD_GREP, PSTR("[-vcinE] S"));
+	help_print_f2a(CMD_SEQ, PSTR("[-w] [-s S] X [N] Y"));
+	help_print_f2a(CMD_WC, PSTR("[-lwc]"));
+	help_print_f2a(CMD_HEAD, PSTR("[-n N]"));
+	help_print_f2a(CMD_TAIL, PSTR("[-n N]"));
+	help_print_f2a(CMD_TR, PSTR("S1 S2|-d S1"));
+	help_print_f2a(CMD_UNIQ, PSTR("[-cd]"));
+	help_print_f2a(CMD_CUT, PSTR("-c LIST"));
+	help_print_f1(CMD_XXD);
+	help_print_f2a(CMD_CKSUM, PSTR("[-16]: CRC, bytes, rate"));
+	help_print_f2a(CMD_WATCH, PSTR("[-n N] CMD"));
+
+	// Buffers
+	help_print_f0(PSTR("Buffers (CMD > B, CMD < B):"));
+	help_print_f2a(CMD_CAT, PSTR("B|F"));
+	help_print_f2a(CMD_BUF, PSTR("[del B]"));
+
+	// Files
+	help_print_f0(PSTR("Files (CMD >> F, CMD < F):"));
+	help_print_f1(CMD_LS);
+	help_print_f2a(CMD_WRITE, PSTR("F TEXT"));
+	help_print_f2a(CMD_RM, PSTR("F"));
+	help_print_f2(CMD_DF, PSTR("show free space"));
 #ifdef SERIAL_EXTRA_SUPPORT
-	help_print_f2(CMD_SERIAL_PROXY, "start serial proxy");
+	help_print_f2(CMD_SERIAL_PROXY, PSTR("start serial proxy"));
 #endif
+
+	// Scripts
+	help_print_f0(PSTR("Scripts:"));
+	help_print_f2a(CMD_SCRIPT, PSTR("save|run|show|del N"));
+	help_print_f2a(CMD_SCRIPT, PSTR("list"));
+	help_print_f2a(CMD_ALIAS, PSTR("N CMD"));
+	help_print_f2a(CMD_ALIAS, PSTR("-d N"));
 }
 
+// The command names and help text are all kept in flash.
 static void help_print_f0(const char* s)
 {
-	serial_write(s, strlen(s));
+	serial_write_P(s);
 	serial_write_newline();
 }
 
 static void help_print_f1(const char* cmd)
 {
-	char buf[HELP_LINE_MAX_LENGTH];
-
-	sprintf(buf, " %s", cmd);
-	serial_write(buf, strlen(buf));
+	serial_tx_byte(' ');
+	serial_write_P(cmd);
 	serial_write_newline();
 }
 
 static void help_print_f2(const char* cmd, const char* cmd_help)
 {
-	char buf[HELP_LINE_MAX_LENGTH];
-
-	sprintf(buf, " %s: %s", cmd, cmd_help);
-	serial_write(buf, strlen(buf));
+	serial_tx_byte(' ');
+	serial_write_P(cmd);
+	serial_write_P(PSTR(": "));
+	serial_write_P(cmd_help);
 	serial_write_newline();
 }
 
 static void help_print_f2a(const char* cmd, const char* cmd_help)
 {
-	char buf[HELP_LINE_MAX_LENGTH];
-
-	sprintf(buf, " %s %s", cmd, cmd_help);
-	serial_write(buf, strlen(buf));
+	serial_tx_byte(' ');
+	serial_write_P(cmd);
+	serial_tx_byte(' ');
+	serial_write_P(cmd_help);
 	serial_write_newline();
 }
 
@@ -598,65 +1262,80 @@ static void pc_led(bool set)
 
 static void pc_sys_info()
 {
-	char buf[40];
+	char buf[FMT_U32_MAX_LEN];
 
 	unsigned short ticks[2];
 	timer_get_tick_count(ticks);
 
-	// TODO: Fix? This will overflow after 65535 seconds.
-	short s = ticks[0] * TIMER_SECONDS_PER_UPPER_TICK + (ticks[1] / TIMER_TICKS_PER_SECOND);
+	const unsigned long s = (unsigned long)ticks[0] * TIMER_SECONDS_PER_UPPER_TICK + (ticks[1] / TIMER_TICKS_PER_SECOND);
 
-	sprintf(buf, "MCU: %s\r\n", AVR_MCU_TYPE);
-	serial_write(buf, strlen(buf));
+	sys_info_write(PSTR("MCU: "));
+	sys_info_write(PSTR(AVR_MCU_TYPE));
+	serial_write_newline();
 
-	sprintf(buf, "uptime: %u s\r\n", s);
-	serial_write(buf, strlen(buf));
+	sys_info_write(PSTR("uptime: "));
+	serial_write(buf, fmt_u32(buf, s));
+	sys_info_write(PSTR(" s"));
+	serial_write_newline();
 
 	unsigned short w[2];
 	pm_get_wake_count(w);
 
-	sprintf(buf, "recent CPU usage: %u/%u\r\n", w[0], w[1]);
-	serial_write(buf, strlen(buf));
+	sys_info_write(PSTR("recent CPU usage: "));
+	serial_write(buf, fmt_u16(buf, w[0]));
+	serial_tx_byte('/');
+	serial_write(buf, fmt_u16(buf, w[1]));
+	serial_write_newline();
 
-	sprintf(buf, "ticks: 0x%04x 0x%04x\r\n", ticks[0], ticks[1]);
-	serial_write(buf, strlen(buf));
+	sys_info_write(PSTR("ticks: 0x"));
+	serial_write(buf, fmt_hex(buf, ticks[0], 4));
+	sys_info_write(PSTR(" 0x"));
+	serial_write(buf, fmt_hex(buf, ticks[1], 4));
+	serial_write_newline();
 
-	sprintf(buf, "ticks/s: %u\r\n", TIMER_TICKS_PER_SECOND);
-	serial_write(buf, strlen(buf));
+	sys_info_write(PSTR("ticks/s: "));
+	serial_write(buf, fmt_u16(buf, TIMER_TICKS_PER_SECOND));
+	serial_write_newline();
 
-	sprintf(buf, "notify timers: %u\r\n", timer_get_notify_registered_count());
-	serial_write(buf, strlen(buf));
+	sys_info_write(PSTR("notify timers: "));
+	serial_write(buf, fmt_u16(buf, timer_get_notify_registered_count()));
+	serial_write_newline();
 
-	sprintf(buf, "thread switches: %u\r\n", thread_switch_count());
-	serial_write(buf, strlen(buf));
+	sys_info_write(PSTR("thread switches: "));
+	serial_write(buf, fmt_u16(buf, thread_switch_count()));
+	serial_write_newline();
 
 	short temp = thermal_read_temperature();
-	sprintf(buf, "internal temp: ", temp);
-	serial_write(buf, strlen(buf));
+	sys_info_write(PSTR("internal temp: "));
 	if (temp != THERMAL_TEMP_NONE)
 	{
-		sprintf(buf, "%d C", temp);
+		serial_write(buf, fmt_i16(buf, temp));
+		sys_info_write(PSTR(" C"));
 	}
 	else
 	{
-		sprintf(buf, "N/A");
+		sys_info_write(PSTR("N/A"));
 	}
-	serial_write(buf, strlen(buf));
 	serial_write_newline();
 }
 
+static void sys_info_write(const char* s)
+{
+	serial_write_P(s);
+}
+
 static void pc_time()
 {
 	char buf[10];
 	if (!time_is_set())
 	{
-		sprintf(buf, "not set\r\n");
+		sprintf_P(buf, PSTR("not set\r\n"));
 	}
 	else
 	{
 		char timebuf[10];
 		time_get_time(timebuf);
-		sprintf(buf, "%s\r\n", timebuf);
+		sprintf_P(buf, PSTR("%s\r\n"), timebuf);
 	}
 
 	serial_write(buf, strlen(buf));
@@ -665,19 +1344,19 @@ static void pc_time()
 static void pc_settime(const char* cmd_str)
 {
 	char buf[40];
-	if (strlen(cmd_str) < strlen(CMD_SET_TIME) + 1 + 8)
+	if (strlen(cmd_str) < strlen_P(CMD_SET_TIME) + 1 + 8)
 	{
-		sprintf(buf, "invalid format\r\n");
+		sprintf_P(buf, PSTR("invalid format\r\n"));
 	}
 	else
 	{
-		if (time_set_time(cmd_str + strlen(CMD_SET_TIME) + 1))
+		if (time_set_time(cmd_str + strlen_P(CMD_SET_TIME) + 1))
 		{
-			sprintf(buf, "time set: %s\r\n", cmd_str + strlen(CMD_SET_TIME) + 1);
+			sprintf_P(buf, PSTR("time set: %s\r\n"), cmd_str + strlen_P(CMD_SET_TIME) + 1);
 		}
 		else
 		{
-			sprintf(buf, "time not set\r\n");
+			sprintf_P(buf, PSTR("time not set\r\n"));
 		}
 	}
 
@@ -691,15 +1370,15 @@ static void pc_clear()
 
 static void pc_sleep(const char* cmd_str)
 {
-	if (strlen(cmd_str) < strlen(CMD_SLEEP) + 1 + 1 ||
-		strlen(cmd_str) > strlen(CMD_SLEEP) + 1 + 4)
+	if (strlen(cmd_str) < strlen_P(CMD_SLEEP) + 1 + 1 ||
+		strlen(cmd_str) > strlen_P(CMD_SLEEP) + 1 + 4)
 	{
 		return;
 	}
 
 	short i;
 
-	const unsigned short nlen = strlen(cmd_str) - strlen(CMD_SLEEP) - 1;
+	const unsigned short nlen = strlen(cmd_str) - strlen_P(CMD_SLEEP) - 1;
 	unsigned short mul = 1;
 	for (i = 1; i < nlen; i++)
 	{
@@ -707,7 +1386,7 @@ static void pc_sleep(const char* cmd_str)
 	}
 
 	unsigned short sleep_sec = 0;
-	const char* cmd_str_n = cmd_str + strlen(CMD_SLEEP) + 1;
+	const char* cmd_str_n = cmd_str + strlen_P(CMD_SLEEP) + 1;
 	for (i = 0; i < nlen; i++)
 	{
 		if (!util_is_numeric(cmd_str_n[i]))
@@ -733,10 +1412,45 @@ static void pc_rand()
 {
 	char buf[10];
 	short r = rng_rand();
-	sprintf(buf, "%d\r\n", r);
+	sprintf_P(buf, PSTR("%d\r\n"), r);
 	serial_write(buf, strlen(buf));
 }
 
+static void pc_history()
+{
+	char buf[40];
+	char cmd[32];
+
+	const unsigned short count = history_count();
+	const unsigned short last = history_last_number();
+
+	for (unsigned short i = count; i > 0; i--)
+	{
+		if (!history_get(i - 1, cmd, sizeof(cmd)))
+		{
+			break;
+		}
+
+		sprintf_P(buf, PSTR("%5u  %s\r\n"), last - i + 1, cmd);
+		serial_write(buf, strlen(buf));
+	}
+}
+
+static void pc_cat(const char* cmd_str)
+{
+	cmd_str += strlen_P(CMD_CAT);
+	while (*cmd_str == ' ')
+	{
+		cmd_str++;
+	}
+
+	if (!rbuf_cat(cmd_str) && !eefs_cat(cmd_str))
+	{
+		serial_write_P(PSTR("not found"));
+		serial_write_newline();
+	}
+}
+
 static void pc_sp_mon_enable(bool enable)
 {
 	sp_mon_enable(enable);
@@ -773,8 +1487,8 @@ static void pc_sp_mon_info()
 		}
 		bar[j] = 0;
 
-		sprintf(buf,
-			"0x%04x-0x%04x: %s%u\r\n",
+		sprintf_P(buf,
+			PSTR("0x%04x-0x%04x: %s%u\r\n"),
 			i * (1 << SP_MON_BUCKET_SIZE_BITS),
 			(i + 1) * (1 << SP_MON_BUCKET_SIZE_BITS) - 1,
 			bar,
@@ -784,7 +1498,6 @@ static void pc_sp_mon_info()
 
 	if (!show)
 	{
-		sprintf(buf, "no data\r\n");
-		serial_write(buf, strlen(buf));
+		serial_write_P(PSTR("no data\r\n"));
 	}
 }
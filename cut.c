@@ -0,0 +1,171 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cut.h"
+
+#include "serial.h"
+#include "util.h"
+
+// Selects chars by column with "-c LIST", where LIST is a comma separated list
+// of columns (counting from 1) and ranges: "N", "N-M", "N-" and "-M".
+
+#define CUT_MAX_RANGES 4
+
+
+typedef struct
+{
+	unsigned short lo[CUT_MAX_RANGES];
+	unsigned short hi[CUT_MAX_RANGES];
+	unsigned char count;
+} cut_list_t;
+
+
+static bool parse_args(const char* str, cut_list_t* list);
+static bool parse_range(const char** str, unsigned short* lo, unsigned short* hi);
+static bool is_selected(const cut_list_t* list, unsigned short col);
+
+
+void cut_main(void* arg)
+{
+	const char* str = (const char*) arg;
+	cut_list_t list;
+
+	if (!parse_args(str, &list))
+	{
+		serial_write_P(PSTR("bad args"));
+		serial_write_newline();
+
+		return;
+	}
+
+	unsigned short col = 0;
+	bool in_line = false;
+
+	while (true)
+	{
+		unsigned char c = serial_read_next_byte();
+		if (c == 0x03)
+		{
+			return;
+		}
+		else if (c == 0x04)
+		{
+			// A last line without a line ending.
+			if (in_line)
+			{
+				serial_write_newline();
+			}
+			return;
+		}
+		else if (c == 0x0a)
+		{
+			continue;
+		}
+		else if (c == 0x0d)
+		{
+			serial_write_newline();
+			col = 0;
+			in_line = false;
+			continue;
+		}
+
+		in_line = true;
+
+		if (col != 0xffff)
+		{
+			col++;
+		}
+
+		if (is_selected(&list, col))
+		{
+			serial_tx_byte(c);
+		}
+	}
+}
+
+static bool parse_args(const char* str, cut_list_t* list)
+{
+	str += 3; // Skip the "cut" command at the beginning.
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (str[0] != '-' || str[1] != 'c')
+	{
+		return false;
+	}
+	str += 2;
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	list->count = 0;
+	while (true)
+	{
+		if (list->count == CUT_MAX_RANGES || !parse_range(&str, &list->lo[list->count], &list->hi[list->count]))
+		{
+			return false;
+		}
+		list->count++;
+
+		if (*str != ',')
+		{
+			break;
+		}
+		str++;
+	}
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	return (*str == 0x00);
+}
+
+static bool parse_range(const char** str, unsigned short* lo, unsigned short* hi)
+{
+	*lo = 1;
+	*hi = 0xffff;
+
+	const bool has_lo = util_is_numeric(**str);
+	if (has_lo && (!util_parse_u16(str, lo) || *lo == 0))
+	{
+		return false;
+	}
+
+	if (**str != '-')
+	{
+		*hi = *lo;
+		return has_lo;
+	}
+	(*str)++;
+
+	const bool has_hi = util_is_numeric(**str);
+	if (has_hi && !util_parse_u16(str, hi))
+	{
+		return false;
+	}
+
+	// Not just "-" on its own.
+	return ((has_lo || has_hi) && *hi >= *lo);
+}
+
+static bool is_selected(const cut_list_t* list, unsigned short col)
+{
+	for (unsigned char i = 0; i < list->count; i++)
+	{
+		if (col >= list->lo[i] && col <= list->hi[i])
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,6 @@
+#ifndef _CUT_H_
+#define _CUT_H_
+
+void cut_main(void* arg);
+
+#endif // _CUT_H_
@@ -1,28 +1,28 @@
-#include <stdio.h>
-#include <string.h>
-
 #include "draw.h"
 
+#include "fmt.h"
 #include "serial.h"
 #include "term.h"
 
 #define SPACE_CHAR ' '
 
+// Not yet set, so the first draw_set_bg() always writes.
+#define DRAW_BG_UNKNOWN 0xff
+
+// "ESC[4Nm"
+#define DRAW_BG_MAX_LEN 5
+
 
-static void set_term_bg(draw_bg_setting bg);
+static unsigned char _bg = DRAW_BG_UNKNOWN;
 
 
 void draw_vertical(short x, short y, short h, char c)
 {
-	term_move_cursor(x, y);
-
 	for (short i = 0; i < h; i++)
 	{
-		if (i != 0)
-		{
-			serial_write("\e[B\e[D", 6);
-		}
-		serial_tx_byte(c);
+		// After the first row, this is LF and BS.
+		term_move_cursor(x, y + i);
+		term_write(&c, 1);
 	}
 }
 
@@ -32,7 +32,7 @@ void draw_horizontal(short x, short y, short l, char c)
 
 	for (short i = 0; i < l; i++)
 	{
-		serial_tx_byte(c);
+		term_write(&c, 1);
 	}
 }
 
@@ -51,8 +51,12 @@ void draw_border(short w, short h, short c)
 		else
 		{
 			serial_tx_byte(c);
-			sprintf(buf, "\e[%uC", w - 2);
-			serial_write(buf, strlen(buf));
+			unsigned char len = 2;
+			buf[0] = '\e';
+			buf[1] = '[';
+			len += fmt_u16(buf + len, w - 2);
+			buf[len++] = 'C';
+			serial_write(buf, len);
 			serial_tx_byte(c);
 		}
 		serial_write_newline();
@@ -61,21 +65,26 @@ void draw_border(short w, short h, short c)
 
 void draw_vertical_bg(short x, short y, short h, draw_bg_setting bg)
 {
-	set_term_bg(bg);
+	draw_set_bg(bg);
 	draw_vertical(x, y, h, SPACE_CHAR);
-	set_term_bg(DRAW_BG_RESET);
+	draw_set_bg(DRAW_BG_RESET);
 }
 
 void draw_horizontal_bg(short x, short y, short l, draw_bg_setting bg)
 {
-	set_term_bg(bg);
+	draw_set_bg(bg);
 	draw_horizontal(x, y, l, SPACE_CHAR);
-	set_term_bg(DRAW_BG_RESET);
+	draw_set_bg(DRAW_BG_RESET);
 }
 
-
-static void set_term_bg(draw_bg_setting bg)
+// Returns the number of bytes written, which is 0 if the background is already set.
+unsigned char draw_set_bg(draw_bg_setting bg)
 {
+	if (_bg == bg)
+	{
+		return 0;
+	}
+
 	unsigned short bg_code;
 	switch (bg)
 	{
@@ -94,7 +103,24 @@ static void set_term_bg(draw_bg_setting bg)
 		break;
 	}
 
-	char buf[8];
-	sprintf(buf, "\e[%um", bg_code);
-	serial_write(buf, strlen(buf));
+	// "ESC[m" is the same as "ESC[0m".
+	char buf[DRAW_BG_MAX_LEN];
+	unsigned char len = 2;
+	buf[0] = '\e';
+	buf[1] = '[';
+	if (bg_code != 0)
+	{
+		len += fmt_u16(buf + len, bg_code);
+	}
+	buf[len++] = 'm';
+	term_write_control(buf, len);
+
+	_bg = bg;
+
+	return len;
+}
+
+bool draw_bg_is(draw_bg_setting bg)
+{
+	return (_bg == bg);
 }
@@ -1,6 +1,8 @@
 #ifndef _DRAW_H_
 #define _DRAW_H_
 
+#include <stdbool.h>
+
 typedef enum {
 	DRAW_BG_RESET = 0,
 	DRAW_BG_RED = 1,
@@ -15,4 +17,7 @@ void draw_border(short w, short h, short c);
 void draw_vertical_bg(short x, short y, short h, draw_bg_setting bg);
 void draw_horizontal_bg(short x, short y, short l, draw_bg_setting bg);
 
+unsigned char draw_set_bg(draw_bg_setting bg);
+bool draw_bg_is(draw_bg_setting bg);
+
 #endif // _DRAW_H_
@@ -0,0 +1,196 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "ee.h"
+
+#include "avr_mcu.h"
+#include "pm.h"
+
+// EEPROM writes are queued and programmed from the EE_READY interrupt, one byte
+// per interrupt, so that callers never wait out the ~3.4 ms programming time of
+// each byte (unless the queue is full). Queued bytes are kept as runs of
+// consecutive addresses ("segments"), with the data for all segments stored in
+// one byte ring in queue order.
+
+
+typedef struct
+{
+	unsigned short addr;
+	unsigned char len;
+} ee_seg_t;
+
+static volatile unsigned char _q[EE_QUEUE_SIZE];
+static volatile unsigned char _q_head = 0;
+static volatile unsigned char _q_count = 0;
+
+static volatile ee_seg_t _segs[EE_QUEUE_SEGS];
+static volatile unsigned char _seg_head = 0;
+static volatile unsigned char _seg_count = 0;
+
+
+static unsigned char hw_read(unsigned short addr);
+
+
+ISR(EE_READY_vect)
+{
+	while (_seg_count != 0)
+	{
+		volatile ee_seg_t* s = &_segs[_seg_head];
+
+		const unsigned short addr = s->addr;
+		const unsigned char c = _q[_q_head];
+
+		_q_head = ((_q_head + 1) % EE_QUEUE_SIZE);
+		_q_count--;
+
+		s->addr++;
+		if (--(s->len) == 0)
+		{
+			_seg_head = ((_seg_head + 1) % EE_QUEUE_SEGS);
+			_seg_count--;
+		}
+
+		// Skip bytes which already hold the value, to save both time and wear.
+		EEAR = addr;
+		EECR |= (1 << EERE);
+		if (EEDR != c)
+		{
+			EEDR = c;
+			EECR |= (1 << EEMPE);
+			EECR |= (1 << EEPE);
+			return;
+		}
+	}
+
+	EECR &= ~(1 << EERIE);
+}
+
+
+unsigned char ee_read(unsigned short addr)
+{
+	// Queued writes take precedence over what is currently in EEPROM.
+	const unsigned char sreg = SREG;
+	cli();
+
+	bool found = false;
+	unsigned char c;
+	unsigned char q = _q_head;
+	unsigned char seg = _seg_head;
+
+	for (unsigned char i = 0; i < _seg_count; i++)
+	{
+		const unsigned short seg_addr = _segs[seg].addr;
+		const unsigned char seg_len = _segs[seg].len;
+
+		if (addr >= seg_addr && addr < seg_addr + seg_len)
+		{
+			c = _q[(q + (addr - seg_addr)) % EE_QUEUE_SIZE];
+			found = true;
+		}
+
+		q = ((q + seg_len) % EE_QUEUE_SIZE);
+		seg = ((seg + 1) % EE_QUEUE_SEGS);
+	}
+
+	SREG = sreg;
+
+	return (found ? c : hw_read(addr));
+}
+
+void ee_read_block(void* dst, unsigned short addr, unsigned short len)
+{
+	unsigned char* d = (unsigned char*)dst;
+	for (unsigned short i = 0; i < len; i++)
+	{
+		d[i] = ee_read(addr + i);
+	}
+}
+
+void ee_write(unsigned short addr, unsigned char c)
+{
+	while (true)
+	{
+		// Space in the queue only ever grows outside of this function.
+		const unsigned char sreg = SREG;
+		cli();
+
+		const unsigned char last = ((_seg_head + _seg_count + EE_QUEUE_SEGS - 1) % EE_QUEUE_SEGS);
+		const bool extend = (_seg_count != 0 &&
+			_segs[last].addr + _segs[last].len == addr &&
+			_segs[last].len != 0xff);
+
+		if (_q_count < EE_QUEUE_SIZE && (extend || _seg_count < EE_QUEUE_SEGS))
+		{
+			if (extend)
+			{
+				_segs[last].len++;
+			}
+			else
+			{
+				const unsigned char next = ((_seg_head + _seg_count) % EE_QUEUE_SEGS);
+				_segs[next].addr = addr;
+				_segs[next].len = 1;
+				_seg_count++;
+			}
+
+			_q[(_q_head + _q_count) % EE_QUEUE_SIZE] = c;
+			_q_count++;
+
+			EECR |= (1 << EERIE);
+
+			SREG = sreg;
+			return;
+		}
+
+		SREG = sreg;
+		pm_yield();
+	}
+}
+
+void ee_write_block(const void* src, unsigned short addr, unsigned short len)
+{
+	const unsigned char* s = (const unsigned char*)src;
+	for (unsigned short i = 0; i < len; i++)
+	{
+		ee_write(addr + i, s[i]);
+	}
+}
+
+void ee_flush()
+{
+	while (!ee_is_idle())
+	{
+		pm_yield();
+	}
+}
+
+bool ee_is_idle()
+{
+	return (_seg_count == 0 && (EECR & (1 << EEPE)) == 0);
+}
+
+
+static unsigned char hw_read(unsigned short addr)
+{
+	while (true)
+	{
+		// Can't read while a byte is being programmed, but don't keep interrupts
+		// disabled while waiting for that to finish.
+		while ((EECR & (1 << EEPE)) != 0) { }
+
+		const unsigned char sreg = SREG;
+		cli();
+
+		if ((EECR & (1 << EEPE)) == 0)
+		{
+			EEAR = addr;
+			EECR |= (1 << EERE);
+			const unsigned char c = EEDR;
+
+			SREG = sreg;
+			return c;
+		}
+
+		SREG = sreg;
+	}
+}
@@ -0,0 +1,13 @@
+#ifndef _EE_H_
+#define _EE_H_
+
+#include <stdbool.h>
+
+unsigned char ee_read(unsigned short addr);
+void ee_read_block(void* dst, unsigned short addr, unsigned short len);
+void ee_write(unsigned short addr, unsigned char c);
+void ee_write_block(const void* src, unsigned short addr, unsigned short len);
+void ee_flush();
+bool ee_is_idle();
+
+#endif // _EE_H_
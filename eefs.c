@@ -0,0 +1,711 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <util/crc16.h>
+
+#include "eefs.h"
+
+#include "avr_mcu.h"
+#include "ee.h"
+#include "serial.h"
+
+// A small log-structured filesystem over EEPROM.
+//
+// The region is split into fixed-size blocks, each holding a header and up to
+// EEFS_DATA_SIZE bytes. A file is one inode block (holding its name) plus data
+// blocks numbered from 0. Blocks are never modified in place: changing a block
+// writes a new version with a higher sequence number at the next unused block
+// after the most recently written one, so writes move round-robin through the
+// whole region. On mount, the newest valid version of each block wins, and
+// blocks with a bad CRC (e.g. interrupted by power loss) are ignored.
+//
+// Block header:
+//   [0] file ID (0xff: never written, 0x00: deleted)
+//   [1] kind
+//   [2] data block index
+//   [3] data length
+//   [4..7] sequence number
+//   [8..9] CRC-16 over header bytes 0-7 and the data
+
+#define EEFS_BLOCK_SIZE 32
+#define EEFS_HDR_SIZE 10
+#define EEFS_DATA_SIZE (EEFS_BLOCK_SIZE - EEFS_HDR_SIZE)
+#define EEFS_BLOCKS (EEFS_SIZE / EEFS_BLOCK_SIZE)
+
+#define EEFS_NAME_MAX 8
+#define EEFS_MAX_FILES 15
+
+#define HDR_ID 0
+#define HDR_KIND 1
+#define HDR_INDEX 2
+#define HDR_LEN 3
+#define HDR_SEQ 4
+#define HDR_CRC 8
+
+#define ID_FREE 0xff
+#define ID_DELETED 0x00
+
+#define KIND_INODE 'i'
+#define KIND_DATA 'd'
+
+
+typedef struct
+{
+	unsigned char id;
+	unsigned char kind;
+	unsigned char index;
+	unsigned char len;
+	uint32_t seq;
+	uint16_t crc;
+} eefs_hdr_t;
+
+// Reading and appending are kept apart, as a command may do both at once
+// ("CMD < F >> G").
+typedef struct
+{
+	unsigned char id;
+	unsigned char index;
+	unsigned char len;
+	unsigned char pos;
+	short block;
+} eefs_reader_t;
+
+typedef struct
+{
+	unsigned char id;
+	unsigned char index;
+	unsigned char len;
+	short block;
+	bool error;
+	unsigned char data[EEFS_DATA_SIZE];
+} eefs_writer_t;
+
+static unsigned char _live[(EEFS_BLOCKS + 7) >> 3];
+static short _head = -1;
+static uint32_t _seq = 0;
+
+static eefs_reader_t _reader;
+static eefs_writer_t _writer;
+
+
+static void read_hdr(short b, eefs_hdr_t* hdr);
+static bool check_block(short b, eefs_hdr_t* hdr);
+static unsigned short block_addr(short b);
+static bool is_live(short b);
+static void set_live(short b, bool live);
+static short find_inode(const char* name, unsigned char len);
+static short find_data(unsigned char id, unsigned char index);
+static short find_last_data(unsigned char id);
+static unsigned short file_size(unsigned char id);
+static short create_file(const char* name, unsigned char len);
+static short alloc_block();
+static bool write_block(unsigned char id, unsigned char kind, unsigned char index, const unsigned char* data, unsigned char len);
+static void flush_stream();
+static void append_byte(unsigned char c);
+static unsigned char read_byte();
+static unsigned char name_len(const char* name);
+static const char* skip_spaces(const char* str);
+static void write_msg(const char* msg);
+
+
+void eefs_init()
+{
+	eefs_hdr_t hdr;
+	eefs_hdr_t other;
+	short b;
+
+	memset(_live, 0, sizeof(_live));
+
+	// Find all blocks with a valid CRC, and the most recently written one.
+	for (b = 0; b < EEFS_BLOCKS; b++)
+	{
+		if (!check_block(b, &hdr))
+		{
+			continue;
+		}
+
+		set_live(b, true);
+
+		if (_head < 0 || hdr.seq >= _seq)
+		{
+			_seq = hdr.seq + 1;
+			_head = b;
+		}
+	}
+
+	// Drop blocks superseded by a newer version, and data without an inode.
+	for (b = 0; b < EEFS_BLOCKS; b++)
+	{
+		if (!is_live(b))
+		{
+			continue;
+		}
+
+		read_hdr(b, &hdr);
+
+		bool has_inode = (hdr.kind == KIND_INODE);
+		bool superseded = false;
+		for (short o = 0; o < EEFS_BLOCKS; o++)
+		{
+			if (o == b || !is_live(o) || ee_read(block_addr(o) + HDR_ID) != hdr.id)
+			{
+				continue;
+			}
+
+			read_hdr(o, &other);
+
+			if (other.kind == hdr.kind && other.index == hdr.index && other.seq > hdr.seq)
+			{
+				superseded = true;
+			}
+
+			if (other.kind == KIND_INODE)
+			{
+				has_inode = true;
+			}
+		}
+
+		if (!has_inode)
+		{
+			// Left behind by an "rm" cut short. Mark it as deleted, so that it
+			// can't turn up in a new file given the same ID.
+			ee_write(block_addr(b) + HDR_ID, ID_DELETED);
+			set_live(b, false);
+		}
+		else if (superseded)
+		{
+			set_live(b, false);
+		}
+	}
+}
+
+bool eefs_start_append(const char* name)
+{
+	const unsigned char len = name_len(name);
+	if (serial_get_tx_hook() != 0 || len == 0 || len > EEFS_NAME_MAX)
+	{
+		return false;
+	}
+
+	short inode = find_inode(name, len);
+	if (inode < 0)
+	{
+		inode = create_file(name, len);
+		if (inode < 0)
+		{
+			return false;
+		}
+	}
+
+	const unsigned char id = ee_read(block_addr(inode) + HDR_ID);
+	if (serial_get_rx_hook() == &read_byte && _reader.id == id)
+	{
+		// The command would read back what it appends, and never see an end.
+		return false;
+	}
+
+	_writer.id = id;
+	_writer.error = false;
+	_writer.len = 0;
+	_writer.block = find_last_data(_writer.id);
+
+	if (_writer.block < 0)
+	{
+		_writer.index = 0;
+	}
+	else
+	{
+		// Continue filling the last block, if it has room left.
+		eefs_hdr_t hdr;
+		read_hdr(_writer.block, &hdr);
+
+		_writer.index = hdr.index;
+		if (hdr.len < EEFS_DATA_SIZE)
+		{
+			_writer.len = hdr.len;
+			ee_read_block(_writer.data, block_addr(_writer.block) + EEFS_HDR_SIZE, hdr.len);
+		}
+		else
+		{
+			_writer.index++;
+			_writer.block = -1;
+		}
+	}
+
+	serial_set_tx_hook(&append_byte);
+
+	return true;
+}
+
+// Returns false if the filesystem ran out of space.
+bool eefs_end_append()
+{
+	serial_set_tx_hook(0);
+	flush_stream();
+
+	return !_writer.error;
+}
+
+bool eefs_start_read(const char* name)
+{
+	const unsigned char len = name_len(name);
+	if (serial_get_rx_hook() != 0 || len == 0)
+	{
+		return false;
+	}
+
+	short inode = find_inode(name, len);
+	if (inode < 0)
+	{
+		return false;
+	}
+
+	const unsigned char id = ee_read(block_addr(inode) + HDR_ID);
+	if (serial_get_tx_hook() == &append_byte && _writer.id == id)
+	{
+		// As in eefs_start_append().
+		return false;
+	}
+
+	_reader.id = id;
+	_reader.index = 0;
+	_reader.pos = 0;
+	_reader.len = 0;
+	_reader.block = -1;
+
+	serial_set_rx_hook(&read_byte);
+
+	return true;
+}
+
+void eefs_end_read()
+{
+	serial_set_rx_hook(0);
+}
+
+bool eefs_cat(const char* name)
+{
+	if (!eefs_start_read(name))
+	{
+		return false;
+	}
+
+	unsigned char c;
+	while ((c = read_byte()) != 0x04)
+	{
+		serial_tx_byte(c);
+	}
+
+	eefs_end_read();
+
+	return true;
+}
+
+void eefs_ls()
+{
+	char buf[32];
+	char name[EEFS_NAME_MAX + 1];
+	eefs_hdr_t hdr;
+
+	for (short b = 0; b < EEFS_BLOCKS; b++)
+	{
+		if (!is_live(b))
+		{
+			continue;
+		}
+
+		read_hdr(b, &hdr);
+		if (hdr.kind != KIND_INODE || hdr.len > EEFS_NAME_MAX)
+		{
+			continue;
+		}
+
+		ee_read_block(name, block_addr(b) + EEFS_HDR_SIZE, hdr.len);
+		name[hdr.len] = 0x00;
+
+		sprintf_P(buf, PSTR("%-8s %5u\r\n"), name, file_size(hdr.id));
+		serial_write(buf, strlen(buf));
+	}
+}
+
+void eefs_df()
+{
+	unsigned short used = 0;
+	for (short b = 0; b < EEFS_BLOCKS; b++)
+	{
+		if (is_live(b))
+		{
+			used++;
+		}
+	}
+
+	char buf[40];
+	sprintf_P(buf, PSTR("blocks: %u/%u used, %u B each\r\n"), used, EEFS_BLOCKS, EEFS_DATA_SIZE);
+	serial_write(buf, strlen(buf));
+	sprintf_P(buf, PSTR("free: %u B\r\n"), (EEFS_BLOCKS - used) * EEFS_DATA_SIZE);
+	serial_write(buf, strlen(buf));
+}
+
+void eefs_rm_main(const char* str)
+{
+	str = skip_spaces(str + 2); // Skip the "rm" command at the beginning.
+
+	short inode = find_inode(str, name_len(str));
+	if (inode < 0)
+	{
+		write_msg(PSTR("not found"));
+		return;
+	}
+
+	const unsigned char id = ee_read(block_addr(inode) + HDR_ID);
+
+	// The inode goes first, so any data blocks left behind by a power loss are
+	// dropped on the next mount.
+	ee_write(block_addr(inode) + HDR_ID, ID_DELETED);
+	set_live(inode, false);
+
+	// Older versions of the blocks go too, even though they aren't live, as the
+	// ID may be given to a new file, which mustn't pick them up on a mount.
+	for (short b = 0; b < EEFS_BLOCKS; b++)
+	{
+		if (ee_read(block_addr(b) + HDR_ID) == id)
+		{
+			ee_write(block_addr(b) + HDR_ID, ID_DELETED);
+			set_live(b, false);
+		}
+	}
+}
+
+void eefs_write_main(const char* str)
+{
+	str = skip_spaces(str + 5); // Skip the "write" command at the beginning.
+
+	const char* text = skip_spaces(str + name_len(str));
+	if (!eefs_start_append(str))
+	{
+		write_msg(PSTR("bad args"));
+		return;
+	}
+
+	serial_write(text, strlen(text));
+	serial_write_newline();
+
+	if (!eefs_end_append())
+	{
+		write_msg(PSTR("no space"));
+	}
+}
+
+
+static void read_hdr(short b, eefs_hdr_t* hdr)
+{
+	const unsigned short addr = block_addr(b);
+
+	hdr->id = ee_read(addr + HDR_ID);
+	hdr->kind = ee_read(addr + HDR_KIND);
+	hdr->index = ee_read(addr + HDR_INDEX);
+	hdr->len = ee_read(addr + HDR_LEN);
+	ee_read_block(&hdr->seq, addr + HDR_SEQ, sizeof(hdr->seq));
+	ee_read_block(&hdr->crc, addr + HDR_CRC, sizeof(hdr->crc));
+}
+
+static bool check_block(short b, eefs_hdr_t* hdr)
+{
+	read_hdr(b, hdr);
+
+	if (hdr->id == ID_FREE || hdr->id == ID_DELETED || hdr->id > EEFS_MAX_FILES ||
+		(hdr->kind != KIND_INODE && hdr->kind != KIND_DATA) ||
+		hdr->len > EEFS_DATA_SIZE)
+	{
+		return false;
+	}
+
+	const unsigned short addr = block_addr(b);
+	uint16_t crc = 0xffff;
+	for (unsigned char i = 0; i < HDR_CRC; i++)
+	{
+		crc = _crc_ccitt_update(crc, ee_read(addr + i));
+	}
+	for (unsigned char i = 0; i < hdr->len; i++)
+	{
+		crc = _crc_ccitt_update(crc, ee_read(addr + EEFS_HDR_SIZE + i));
+	}
+
+	return (crc == hdr->crc);
+}
+
+static unsigned short block_addr(short b)
+{
+	return (EEFS_ADDR + b * EEFS_BLOCK_SIZE);
+}
+
+static bool is_live(short b)
+{
+	return ((_live[b >> 3] & (1 << (b & 0x07))) != 0);
+}
+
+static void set_live(short b, bool live)
+{
+	if (live)
+	{
+		_live[b >> 3] |= (1 << (b & 0x07));
+	}
+	else
+	{
+		_live[b >> 3] &= ~(1 << (b & 0x07));
+	}
+}
+
+static short find_inode(const char* name, unsigned char len)
+{
+	eefs_hdr_t hdr;
+
+	for (short b = 0; b < EEFS_BLOCKS; b++)
+	{
+		if (!is_live(b))
+		{
+			continue;
+		}
+
+		read_hdr(b, &hdr);
+		if (hdr.kind != KIND_INODE || hdr.len != len)
+		{
+			continue;
+		}
+
+		unsigned char i = 0;
+		while (i < len && ee_read(block_addr(b) + EEFS_HDR_SIZE + i) == name[i])
+		{
+			i++;
+		}
+
+		if (i == len)
+		{
+			return b;
+		}
+	}
+
+	return -1;
+}
+
+static short find_data(unsigned char id, unsigned char index)
+{
+	for (short b = 0; b < EEFS_BLOCKS; b++)
+	{
+		const unsigned short addr = block_addr(b);
+		if (is_live(b) &&
+			ee_read(addr + HDR_ID) == id &&
+			ee_read(addr + HDR_KIND) == KIND_DATA &&
+			ee_read(addr + HDR_INDEX) == index)
+		{
+			return b;
+		}
+	}
+
+	return -1;
+}
+
+static short find_last_data(unsigned char id)
+{
+	short last = -1;
+	short last_index = -1;
+
+	for (short b = 0; b < EEFS_BLOCKS; b++)
+	{
+		const unsigned short addr = block_addr(b);
+		if (is_live(b) &&
+			ee_read(addr + HDR_ID) == id &&
+			ee_read(addr + HDR_KIND) == KIND_DATA &&
+			ee_read(addr + HDR_INDEX) > last_index)
+		{
+			last = b;
+			last_index = ee_read(addr + HDR_INDEX);
+		}
+	}
+
+	return last;
+}
+
+static unsigned short file_size(unsigned char id)
+{
+	unsigned short size = 0;
+
+	for (short b = 0; b < EEFS_BLOCKS; b++)
+	{
+		const unsigned short addr = block_addr(b);
+		if (is_live(b) && ee_read(addr + HDR_ID) == id && ee_read(addr + HDR_KIND) == KIND_DATA)
+		{
+			size += ee_read(addr + HDR_LEN);
+		}
+	}
+
+	return size;
+}
+
+static short create_file(const char* name, unsigned char len)
+{
+	// Find an unused file ID.
+	unsigned char id;
+	for (id = 1; id <= EEFS_MAX_FILES; id++)
+	{
+		short b;
+		for (b = 0; b < EEFS_BLOCKS; b++)
+		{
+			if (is_live(b) && ee_read(block_addr(b) + HDR_ID) == id)
+			{
+				break;
+			}
+		}
+
+		if (b == EEFS_BLOCKS)
+		{
+			break;
+		}
+	}
+
+	if (id > EEFS_MAX_FILES || !write_block(id, KIND_INODE, 0, name, len))
+	{
+		return -1;
+	}
+
+	return _head;
+}
+
+// Picks the next unused block after the most recently written one.
+static short alloc_block()
+{
+	short b = _head;
+
+	for (short i = 0; i < EEFS_BLOCKS; i++)
+	{
+		b = (b + 1) % EEFS_BLOCKS;
+		if (!is_live(b))
+		{
+			return b;
+		}
+	}
+
+	return -1;
+}
+
+static bool write_block(unsigned char id, unsigned char kind, unsigned char index, const unsigned char* data, unsigned char len)
+{
+	const short b = alloc_block();
+	if (b < 0)
+	{
+		return false;
+	}
+
+	unsigned char hdr[EEFS_HDR_SIZE];
+	hdr[HDR_ID] = id;
+	hdr[HDR_KIND] = kind;
+	hdr[HDR_INDEX] = index;
+	hdr[HDR_LEN] = len;
+	memcpy(hdr + HDR_SEQ, &_seq, sizeof(_seq));
+
+	uint16_t crc = 0xffff;
+	for (unsigned char i = 0; i < HDR_CRC; i++)
+	{
+		crc = _crc_ccitt_update(crc, hdr[i]);
+	}
+	for (unsigned char i = 0; i < len; i++)
+	{
+		crc = _crc_ccitt_update(crc, data[i]);
+	}
+	memcpy(hdr + HDR_CRC, &crc, sizeof(crc));
+
+	const unsigned short addr = block_addr(b);
+	ee_write_block(hdr, addr, EEFS_HDR_SIZE);
+	ee_write_block(data, addr + EEFS_HDR_SIZE, len);
+
+	set_live(b, true);
+	_head = b;
+	_seq++;
+
+	return true;
+}
+
+static void flush_stream()
+{
+	if (_writer.len == 0 || _writer.error)
+	{
+		return;
+	}
+
+	if (!write_block(_writer.id, KIND_DATA, _writer.index, _writer.data, _writer.len))
+	{
+		_writer.error = true;
+		return;
+	}
+
+	// The new version supersedes the partially filled block it was started from.
+	if (_writer.block >= 0)
+	{
+		set_live(_writer.block, false);
+		_writer.block = -1;
+	}
+}
+
+static void append_byte(unsigned char c)
+{
+	_writer.data[_writer.len++] = c;
+
+	if (_writer.len == EEFS_DATA_SIZE)
+	{
+		flush_stream();
+		_writer.index++;
+		_writer.len = 0;
+	}
+}
+
+static unsigned char read_byte()
+{
+	while (_reader.pos == _reader.len)
+	{
+		if (_reader.block >= 0)
+		{
+			_reader.index++;
+		}
+
+		_reader.block = find_data(_reader.id, _reader.index);
+		if (_reader.block < 0)
+		{
+			// End of file looks like the end of a pipe.
+			return 0x04;
+		}
+
+		_reader.pos = 0;
+		_reader.len = ee_read(block_addr(_reader.block) + HDR_LEN);
+	}
+
+	return ee_read(block_addr(_reader.block) + EEFS_HDR_SIZE + _reader.pos++);
+}
+
+// File names end at a space or pipe, as with command names.
+static unsigned char name_len(const char* name)
+{
+	unsigned char len = 0;
+	while (name[len] != 0x00 && name[len] != ' ' && name[len] != '|')
+	{
+		len++;
+	}
+
+	return len;
+}
+
+static const char* skip_spaces(const char* str)
+{
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	return str;
+}
+
+static void write_msg(const char* msg)
+{
+	serial_write_P(msg);
+	serial_write_newline();
+}
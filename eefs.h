@@ -0,0 +1,19 @@
+#ifndef _EEFS_H_
+#define _EEFS_H_
+
+#include <stdbool.h>
+
+void eefs_init();
+
+bool eefs_start_append(const char* name);
+bool eefs_end_append();
+bool eefs_start_read(const char* name);
+void eefs_end_read();
+
+bool eefs_cat(const char* name);
+void eefs_ls();
+void eefs_df();
+void eefs_rm_main(const char* str);
+void eefs_write_main(const char* str);
+
+#endif // _EEFS_H_
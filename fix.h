@@ -0,0 +1,75 @@
+#ifndef _FIX_H_
+#define _FIX_H_
+
+// Fixed-point values kept in a short: 8.8 (in 1/256ths) for positions and
+// speeds in the games, and 4.12 (in 1/4096ths, from -8 up to 8) where more
+// precision is needed, as for "mandel".
+
+#define FIX8_ONE 256
+#define FIX12_ONE 4096
+
+
+static short fix8_from_int(short c);
+static short fix8_to_int(short v);
+static short fix12_mul(short a, short b);
+
+
+static short fix8_from_int(short c)
+{
+	return (c << 8);
+}
+
+static short fix8_to_int(short v)
+{
+	return (v >> 8);
+}
+
+// The product is rounded down, and must be within the 4.12 range.
+static short fix12_mul(short a, short b)
+{
+#ifdef __AVR_HAVE_MUL__
+	// Signed 16x16 multiply (as in Atmel's AVR201) from four 8x8 multiplies, with
+	// the 32-bit product then shifted right by 4 here and by 8 more below.
+	long r;
+
+	asm (
+		"clr	r26\r\n" \
+		"mul	%A1, %A2\r\n" \
+		"movw	%A0, r0\r\n" \
+		"muls	%B1, %B2\r\n" \
+		"movw	%C0, r0\r\n" \
+		"mulsu	%B1, %A2\r\n" \
+		"sbc	%D0, r26\r\n" \
+		"add	%B0, r0\r\n" \
+		"adc	%C0, r1\r\n" \
+		"adc	%D0, r26\r\n" \
+		"mulsu	%B2, %A1\r\n" \
+		"sbc	%D0, r26\r\n" \
+		"add	%B0, r0\r\n" \
+		"adc	%C0, r1\r\n" \
+		"adc	%D0, r26\r\n" \
+		"clr	r1\r\n" \
+		"asr	%D0\r\n" \
+		"ror	%C0\r\n" \
+		"ror	%B0\r\n" \
+		"asr	%D0\r\n" \
+		"ror	%C0\r\n" \
+		"ror	%B0\r\n" \
+		"asr	%D0\r\n" \
+		"ror	%C0\r\n" \
+		"ror	%B0\r\n" \
+		"asr	%D0\r\n" \
+		"ror	%C0\r\n" \
+		"ror	%B0\r\n"
+		: "=&r" (r)
+		: "a" (a), "a" (b)
+		: "r26"
+	);
+
+	return (short)(r >> 8);
+#else
+	return (short)(((long)a * b) >> 12);
+#endif
+}
+
+#endif // _FIX_H_
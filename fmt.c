@@ -0,0 +1,130 @@
+#include "fmt.h"
+
+// Integer formatting without avr-libc's vfprintf, which is both large and slow.
+//
+// Division by 10 is done with a multiply by a reciprocal: (v * 0xcccd) >> 19 is
+// exact for every 16-bit v, and compiles to the MCU's hardware multiply rather
+// than a call to the generic division routine. 32-bit values are brought into
+// 16-bit range with a shift-and-add division by 10 first.
+//
+// All functions write a null-terminated string, and return its length.
+
+static const char HEX_DIGITS[16] = "0123456789abcdef";
+
+
+static unsigned short div10_u16(unsigned short v);
+static unsigned long div10_u32(unsigned long v);
+static unsigned char write_reversed(char* buf, const char* digits, unsigned char n, unsigned char width, char pad);
+
+
+unsigned char fmt_u16(char* buf, unsigned short v)
+{
+	return fmt_u16_pad(buf, v, 0, ' ');
+}
+
+unsigned char fmt_u16_pad(char* buf, unsigned short v, unsigned char width, char pad)
+{
+	char digits[5];
+	unsigned char n = 0;
+
+	do
+	{
+		const unsigned short q = div10_u16(v);
+		digits[n++] = '0' + (v - q * 10);
+		v = q;
+	} while (v != 0);
+
+	return write_reversed(buf, digits, n, width, pad);
+}
+
+unsigned char fmt_u32(char* buf, unsigned long v)
+{
+	return fmt_u32_pad(buf, v, 0, ' ');
+}
+
+unsigned char fmt_u32_pad(char* buf, unsigned long v, unsigned char width, char pad)
+{
+	char digits[10];
+	unsigned char n = 0;
+
+	while (v > 0xffff)
+	{
+		const unsigned long q = div10_u32(v);
+		digits[n++] = '0' + (unsigned char)(v - q * 10);
+		v = q;
+	}
+
+	unsigned short v16 = v;
+	do
+	{
+		const unsigned short q = div10_u16(v16);
+		digits[n++] = '0' + (v16 - q * 10);
+		v16 = q;
+	} while (v16 != 0);
+
+	return write_reversed(buf, digits, n, width, pad);
+}
+
+unsigned char fmt_i16(char* buf, short v)
+{
+	if (v >= 0)
+	{
+		return fmt_u16(buf, v);
+	}
+
+	buf[0] = '-';
+	return 1 + fmt_u16(buf + 1, -(unsigned short)v);
+}
+
+// Always writes the given number of digits, like "%04x".
+unsigned char fmt_hex(char* buf, unsigned short v, unsigned char digits)
+{
+	for (unsigned char i = digits; i > 0; i--)
+	{
+		buf[i - 1] = HEX_DIGITS[v & 0x0f];
+		v >>= 4;
+	}
+
+	buf[digits] = 0x00;
+
+	return digits;
+}
+
+
+static unsigned short div10_u16(unsigned short v)
+{
+	return (((unsigned long)v * 0xcccd) >> 19);
+}
+
+static unsigned long div10_u32(unsigned long v)
+{
+	unsigned long q = (v >> 1) + (v >> 2);
+	q += (q >> 4);
+	q += (q >> 8);
+	q += (q >> 16);
+	q >>= 3;
+
+	// q is either exact or one too small.
+	const unsigned long r = v - ((q << 3) + (q << 1));
+	return (r > 9 ? q + 1 : q);
+}
+
+static unsigned char write_reversed(char* buf, const char* digits, unsigned char n, unsigned char width, char pad)
+{
+	unsigned char len = 0;
+
+	while (width > n)
+	{
+		buf[len++] = pad;
+		width--;
+	}
+
+	while (n != 0)
+	{
+		buf[len++] = digits[--n];
+	}
+
+	buf[len] = 0x00;
+
+	return len;
+}
@@ -0,0 +1,14 @@
+#ifndef _FMT_H_
+#define _FMT_H_
+
+// Longest string written by any of these, including the null terminator.
+#define FMT_U32_MAX_LEN 11
+
+unsigned char fmt_u16(char* buf, unsigned short v);
+unsigned char fmt_u16_pad(char* buf, unsigned short v, unsigned char width, char pad);
+unsigned char fmt_u32(char* buf, unsigned long v);
+unsigned char fmt_u32_pad(char* buf, unsigned long v, unsigned char width, char pad);
+unsigned char fmt_i16(char* buf, short v);
+unsigned char fmt_hex(char* buf, unsigned short v, unsigned char digits);
+
+#endif // _FMT_H_
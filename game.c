@@ -0,0 +1,330 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "game.h"
+
+#include "avr_mcu.h"
+#include "fmt.h"
+#include "rng.h"
+#include "serial.h"
+#include "term.h"
+#include "timer.h"
+
+// "gamestat" shows how the last game kept up with its frame rate: the rate it
+// was stepped and drawn at, the time and bytes per draw (against what the link
+// can send in a frame), and the histograms kept by game.h.
+//
+// "replay" runs the last game again from its recording, with the output going
+// nowhere, and shows the cycles taken per step (and by drawing alone) and the
+// bytes the renderer sent.
+//
+// Keys are recorded as runs of the same key read at consecutive steps, which
+// is how a held key comes in, so that holding a paddle key takes one entry
+// rather than one per step. The recording stops when GAME_RECORD_SIZE runs
+// have been read, and the replay quits at that point.
+
+#define CYCLES_PER_US (F_CPU / 1000000)
+
+
+// Key c read count times, at steps step, step + 1 and so on.
+typedef struct
+{
+	unsigned short step;
+	unsigned char c;
+	unsigned char count;
+} game_input_t;
+
+
+static game_stat_t _last;
+static bool _has_last = false;
+
+static void (*_record_game)() = 0;
+static unsigned short _record_seed;
+static bool _record_term_size;
+static short _record_term_w;
+static short _record_term_h;
+static game_input_t _record[GAME_RECORD_SIZE];
+static unsigned short _record_count;
+static bool _record_full;
+
+static bool _replay = false;
+static unsigned short _replay_pos;
+static unsigned char _replay_count;
+static game_stat_t _replay_stat;
+
+
+static void drop_byte(unsigned char c);
+static void write_rate(const char* name, unsigned long count, unsigned long ticks);
+static void write_ms(const char* name, unsigned long cycles);
+static void write_hist(const char* name, const unsigned short* hist);
+static void write_str(const char* s);
+static void write_u32(unsigned long v);
+
+
+void game_stat_save(const game_stat_t* stat)
+{
+	if (_replay)
+	{
+		memcpy(&_replay_stat, stat, sizeof(game_stat_t));
+		return;
+	}
+
+	memcpy(&_last, stat, sizeof(game_stat_t));
+	_has_last = true;
+}
+
+void game_stat_main()
+{
+	if (!_has_last)
+	{
+		write_str(PSTR("no game played"));
+		serial_write_newline();
+		return;
+	}
+
+	write_str(PSTR("fps target "));
+	write_u32(_last.fps);
+	write_rate(PSTR(", stepped "), _last.steps, _last.ticks);
+	write_rate(PSTR(", drawn "), _last.draws, _last.ticks);
+	serial_write_newline();
+
+	write_str(PSTR("steps "));
+	write_u32(_last.steps);
+	write_str(PSTR(", draws "));
+	write_u32(_last.draws);
+	write_str(PSTR(", skipped "));
+	write_u32(_last.skips);
+	serial_write_newline();
+
+	write_ms(PSTR("draw ms avg "), (_last.draws == 0 ? 0 : _last.draw_cycles / _last.draws));
+	write_ms(PSTR(" max "), _last.max_draw_cycles);
+	serial_write_newline();
+
+	write_str(PSTR("bytes/frame avg "));
+	write_u32(_last.frames == 0 ? 0 : _last.bytes / _last.frames);
+	write_str(PSTR(" max "));
+	write_u32(_last.max_frame_bytes);
+	write_str(PSTR(" budget "));
+	write_u32(SERIAL_BAUDRATE / 10 / _last.fps);
+	serial_write_newline();
+
+	write_str(PSTR("frames   <1/4   <1/2     <1     <2   more"));
+	serial_write_newline();
+	write_hist(PSTR("late  "), _last.late);
+	write_hist(PSTR("draw  "), _last.draw_time);
+}
+
+
+void game_record_start(void (*game)())
+{
+	// Keys typed during the game mustn't change the RNG, or the replay would differ.
+	rng_set_entropy(false);
+
+	if (_replay)
+	{
+		rng_set_seed(_record_seed);
+		return;
+	}
+
+	_record_game = game;
+	_record_seed = rng_get_seed();
+	_record_term_size = false;
+	_record_count = 0;
+	_record_full = false;
+}
+
+void game_record_end()
+{
+	rng_set_entropy(true);
+}
+
+void game_record_input(unsigned long step, unsigned char c)
+{
+	if (_record_full || step > 0xffff)
+	{
+		_record_full = true;
+		return;
+	}
+
+	if (_record_count != 0)
+	{
+		game_input_t* run = &_record[_record_count - 1];
+		if (run->c == c && run->count != 0xff && (unsigned long)run->step + run->count == step)
+		{
+			run->count++;
+			return;
+		}
+	}
+
+	if (_record_count == GAME_RECORD_SIZE)
+	{
+		_record_full = true;
+		return;
+	}
+
+	_record[_record_count].step = step;
+	_record[_record_count].c = c;
+	_record[_record_count].count = 1;
+	_record_count++;
+}
+
+// The terminal size the game was played with, which a replay uses again.
+bool game_get_term_size(short* w, short* h)
+{
+	if (!_replay)
+	{
+		_record_term_size = term_get_size(&_record_term_w, &_record_term_h);
+	}
+
+	*w = _record_term_w;
+	*h = _record_term_h;
+
+	return _record_term_size;
+}
+
+bool game_is_replay()
+{
+	return _replay;
+}
+
+bool game_replay_has_input(unsigned long step)
+{
+	return (_replay_pos == _record_count || (unsigned long)_record[_replay_pos].step + _replay_count <= step);
+}
+
+unsigned char game_replay_input(unsigned long step, bool block)
+{
+	if (_replay_pos == _record_count)
+	{
+		return GAME_QUIT_C;
+	}
+
+	const game_input_t* run = &_record[_replay_pos];
+	if (!block && (unsigned long)run->step + _replay_count > step)
+	{
+		return 0;
+	}
+
+	if (++_replay_count == run->count)
+	{
+		_replay_pos++;
+		_replay_count = 0;
+	}
+
+	return run->c;
+}
+
+void game_replay_main()
+{
+	if (_record_game == 0)
+	{
+		write_str(PSTR("no game recorded"));
+		serial_write_newline();
+		return;
+	}
+
+	const serial_tx_hook_t hook = serial_get_tx_hook();
+	serial_set_tx_hook(&drop_byte);
+
+	_replay = true;
+	_replay_pos = 0;
+	_replay_count = 0;
+
+	const unsigned long c0 = timer_get_cycles();
+	_record_game();
+	const unsigned long c = timer_get_cycles() - c0;
+
+	_replay = false;
+	serial_set_tx_hook(hook);
+
+	const unsigned long steps = (_replay_stat.steps == 0 ? 1 : _replay_stat.steps);
+
+	write_str(PSTR("steps "));
+	write_u32(_replay_stat.steps);
+	unsigned long keys = 0;
+	for (unsigned short i = 0; i < _record_count; i++)
+	{
+		keys += _record[i].count;
+	}
+
+	write_str(PSTR(", keys "));
+	write_u32(keys);
+	write_str(PSTR(" in "));
+	write_u32(_record_count);
+	write_str(PSTR(" runs"));
+	if (_record_full)
+	{
+		write_str(PSTR(" (recording cut short)"));
+	}
+	serial_write_newline();
+
+	write_str(PSTR("cycles/step "));
+	write_u32(c / steps);
+	write_str(PSTR(", drawing "));
+	write_u32(_replay_stat.draw_cycles / steps);
+	serial_write_newline();
+
+	write_str(PSTR("bytes "));
+	write_u32(_replay_stat.bytes);
+	write_str(PSTR(", per frame avg "));
+	write_u32(_replay_stat.frames == 0 ? 0 : _replay_stat.bytes / _replay_stat.frames);
+	write_str(PSTR(" max "));
+	write_u32(_replay_stat.max_frame_bytes);
+	serial_write_newline();
+}
+
+// Count per second, to one decimal place.
+static void write_rate(const char* name, unsigned long count, unsigned long ticks)
+{
+	unsigned long r = 0;
+	if (ticks != 0)
+	{
+		r = (count * TIMER_TICKS_PER_SECOND * 10 + (ticks >> 1)) / ticks;
+	}
+
+	char buf[FMT_U32_MAX_LEN];
+
+	write_str(name);
+	write_u32(r / 10);
+	serial_tx_byte('.');
+	serial_write(buf, fmt_u16(buf, r % 10));
+}
+
+static void write_ms(const char* name, unsigned long cycles)
+{
+	const unsigned long us = cycles / CYCLES_PER_US;
+	char buf[FMT_U32_MAX_LEN];
+
+	write_str(name);
+	write_u32(us / 1000);
+	serial_tx_byte('.');
+	serial_write(buf, fmt_u16_pad(buf, (us % 1000) / 10, 2, '0'));
+}
+
+static void write_hist(const char* name, const unsigned short* hist)
+{
+	char buf[FMT_U32_MAX_LEN];
+
+	write_str(name);
+	for (unsigned char i = 0; i < GAME_HIST_BUCKETS; i++)
+	{
+		serial_write(buf, fmt_u16_pad(buf, hist[i], 7, ' '));
+	}
+	serial_write_newline();
+}
+
+static void drop_byte(unsigned char c)
+{
+}
+
+static void write_str(const char* s)
+{
+	serial_write_P(s);
+}
+
+static void write_u32(unsigned long v)
+{
+	char buf[FMT_U32_MAX_LEN];
+	serial_write(buf, fmt_u32(buf, v));
+}
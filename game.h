@@ -1,56 +1,203 @@
 #ifndef _GAME_H_
 #define _GAME_H_
 
+#include <stdbool.h>
+#include <string.h>
+
 #include "pm.h"
+#include "render.h"
 #include "serial.h"
 #include "timer.h"
 
+// The game is stepped at a fixed rate, and each step is drawn unless the
+// game has fallen behind (usually because the serial link can't send a frame
+// in time, since writes block until each byte is sent). Then the draw is
+// skipped, and the changes stay pending in the renderer to go out with the
+// next one, so the simulation keeps to its rate while fewer frames are sent.
+//
+// The keys read in each game are recorded with the step they were read after,
+// along with the RNG seed, so that "replay" can run the last game again the
+// same way. A replay runs headless (its output is dropped) and steps as fast
+// as it can, drawing every step, to time the game itself.
+
+// Draws skipped in a row before one is made anyway.
+#define GAME_MAX_SKIP 4
+
+// Frames behind at which the missed steps are dropped rather than caught up.
+#define GAME_MAX_LAG 8
+
+// Key which quits every game, and ends a replay once its inputs run out.
+#define GAME_QUIT_C 'Q'
+
+// Histograms of how late steps start, and of how long draws take, in
+// fractions of a frame: under 1/4, 1/2, 1, 2, and 2 or more.
+#define GAME_HIST_BUCKETS 5
+
+
+typedef struct
+{
+	unsigned short fps;
+	unsigned long steps;
+	unsigned long draws;
+	unsigned long skips;
+	unsigned long ticks;
+	unsigned long draw_cycles;
+	unsigned long max_draw_cycles;
+	unsigned long frames;
+	unsigned long bytes;
+	unsigned short max_frame_bytes;
+	unsigned short late[GAME_HIST_BUCKETS];
+	unsigned short draw_time[GAME_HIST_BUCKETS];
+} game_stat_t;
 
 typedef struct
 {
 	unsigned short next_frame_time[2];
 	unsigned short game_frame_ticks;
+	unsigned short last_step_time;
+	bool resume;
+	unsigned char skipped;
+	render_t* render;
+	game_stat_t stat;
 } game_context_t;
 
 
-static void game_context_init(game_context_t* ctx, unsigned short game_fps);
-static bool game_should_draw_frame(game_context_t* ctx);
+void game_stat_save(const game_stat_t* stat);
+void game_stat_main();
+
+void game_record_start(void (*game)());
+void game_record_end();
+void game_record_input(unsigned long step, unsigned char c);
+bool game_get_term_size(short* w, short* h);
+bool game_is_replay();
+bool game_replay_has_input(unsigned long step);
+unsigned char game_replay_input(unsigned long step, bool block);
+void game_replay_main();
+
+
+static void game_context_init(game_context_t* ctx, unsigned short game_fps, render_t* render, void (*game)());
+static void game_context_end(game_context_t* ctx);
+static bool game_should_step(game_context_t* ctx);
+static void game_draw(game_context_t* ctx);
 static unsigned char game_get_char(game_context_t* ctx, bool block);
 static void game_add_frame_time(game_context_t* ctx);
+static void game_hist_add(unsigned short* hist, unsigned long v, unsigned long frame);
 
 
-static void game_context_init(game_context_t* ctx, unsigned short game_fps)
+// Called before the game does anything else, so a replay starts from the same RNG seed.
+static void game_context_init(game_context_t* ctx, unsigned short game_fps, render_t* render, void (*game)())
 {
 	ctx->next_frame_time[0] = 0;
 	ctx->next_frame_time[1] = 0;
 
 	ctx->game_frame_ticks = TIMER_TICKS_PER_SECOND / game_fps;
+
+	ctx->resume = true;
+	ctx->skipped = 0;
+	ctx->render = render;
+
+	memset(&ctx->stat, 0, sizeof(game_stat_t));
+	ctx->stat.fps = game_fps;
+
+	game_record_start(game);
 }
 
-static bool game_should_draw_frame(game_context_t* ctx)
+// Keeps the stats for "gamestat".
+static void game_context_end(game_context_t* ctx)
 {
-	if (ctx->next_frame_time[0] == 0 && ctx->next_frame_time[1] == 0)
+	ctx->stat.frames = ctx->render->frames;
+	ctx->stat.bytes = ctx->render->total_bytes;
+	ctx->stat.max_frame_bytes = ctx->render->max_frame_bytes;
+
+	game_stat_save(&ctx->stat);
+	game_record_end();
+}
+
+static bool game_should_step(game_context_t* ctx)
+{
+	if (game_is_replay())
 	{
-		timer_get_tick_count(ctx->next_frame_time);
-		game_add_frame_time(ctx);
+		// Keys read after the last step go in before the next one.
+		if (game_replay_has_input(ctx->stat.steps))
+		{
+			return false;
+		}
+
+		ctx->stat.steps++;
 		return true;
 	}
 
 	unsigned short t[2];
 	timer_get_tick_count(t);
-	if (timer_compare(t, ctx->next_frame_time) >= 0)
+
+	if (ctx->resume)
 	{
+		// Starting, or going again after waiting for a key, so there is no lateness to count.
 		ctx->next_frame_time[0] = t[0];
 		ctx->next_frame_time[1] = t[1];
-		game_add_frame_time(ctx);
-		return true;
+		ctx->last_step_time = t[1];
+		ctx->resume = false;
+	}
+	else if (timer_compare(t, ctx->next_frame_time) < 0)
+	{
+		return false;
 	}
 
-	return false;
+	// Late steps are still under a second, as they are dropped after GAME_MAX_LAG frames.
+	const unsigned short late = t[1] - ctx->next_frame_time[1];
+	game_hist_add(ctx->stat.late, late, ctx->game_frame_ticks);
+
+	if (late >= GAME_MAX_LAG * ctx->game_frame_ticks)
+	{
+		ctx->next_frame_time[0] = t[0];
+		ctx->next_frame_time[1] = t[1];
+	}
+
+	game_add_frame_time(ctx);
+
+	ctx->stat.ticks += (unsigned short)(t[1] - ctx->last_step_time);
+	ctx->last_step_time = t[1];
+	ctx->stat.steps++;
+
+	return true;
+}
+
+// Draws the frame for the step just taken, unless the next step is already due.
+static void game_draw(game_context_t* ctx)
+{
+	unsigned short t[2];
+	timer_get_tick_count(t);
+
+	if (!game_is_replay() && timer_compare(t, ctx->next_frame_time) >= 0 && ctx->skipped < GAME_MAX_SKIP)
+	{
+		ctx->skipped++;
+		ctx->stat.skips++;
+		return;
+	}
+	ctx->skipped = 0;
+
+	const unsigned long c0 = timer_get_cycles();
+	render_frame(ctx->render);
+	const unsigned long c = timer_get_cycles() - c0;
+
+	game_hist_add(ctx->stat.draw_time, c, (unsigned long)ctx->game_frame_ticks * TIMER_SYSTEM_CLKS_PER_TICK);
+
+	ctx->stat.draw_cycles += c;
+	if (c > ctx->stat.max_draw_cycles)
+	{
+		ctx->stat.max_draw_cycles = c;
+	}
+	ctx->stat.draws++;
 }
 
 static unsigned char game_get_char(game_context_t* ctx, bool block)
 {
+	if (game_is_replay())
+	{
+		return game_replay_input(ctx->stat.steps, block);
+	}
+
+	unsigned char c = 0;
 	if (!block)
 	{
 		unsigned short t[2];
@@ -74,15 +221,32 @@ static unsigned char game_get_char(game_context_t* ctx, bool block)
 
 				if (serial_has_next_byte())
 				{
-					return serial_read_next_byte();
+					timer_notify_unregister(&tn);
+					c = serial_read_next_byte();
+					break;
 				}
 			}
-
-			return 0;
 		}
 	}
+	else
+	{
+		// Anything not drawn yet is drawn before waiting for a key.
+		if (ctx->render->pending_count != 0)
+		{
+			render_frame(ctx->render);
+		}
+
+		ctx->resume = true;
+
+		c = serial_read_next_byte();
+	}
 
-	return serial_read_next_byte();
+	if (c != 0)
+	{
+		game_record_input(ctx->stat.steps, c);
+	}
+
+	return c;
 }
 
 static void game_add_frame_time(game_context_t* ctx)
@@ -94,4 +258,34 @@ static void game_add_frame_time(game_context_t* ctx)
 	}
 }
 
+static void game_hist_add(unsigned short* hist, unsigned long v, unsigned long frame)
+{
+	unsigned char i;
+	if (v < (frame >> 2))
+	{
+		i = 0;
+	}
+	else if (v < (frame >> 1))
+	{
+		i = 1;
+	}
+	else if (v < frame)
+	{
+		i = 2;
+	}
+	else if (v < (frame << 1))
+	{
+		i = 3;
+	}
+	else
+	{
+		i = 4;
+	}
+
+	if (hist[i] != 0xffff)
+	{
+		hist[i]++;
+	}
+}
+
 #endif // _GAME_H_
@@ -1,114 +1,391 @@
+#include <avr/pgmspace.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "grep.h"
+#include "avr_mcu.h"
+#include "rbuf.h"
+#include "regex.h"
 #include "serial.h"
+#include "util.h"
+
+// Input is matched one byte at a time, with a KMP matcher for plain strings or
+// a regex (-E), so no line ever has to be stored in full. Each line is held back
+// in a small buffer until it is known whether it will be printed, and is
+// streamed straight out from then on. A held line which outgrows GREP_HOLD_SIZE
+// bytes goes on into a RAM buffer (see rbuf.c) borrowed for the rest of the
+// run, if one is free. Lines with more bytes than that before the point they
+// are known to be printed (the whole line, with -v) are printed truncated, with
+// "..." in place of the bytes which did not fit, but are always matched and
+// counted correctly.
+
+#define GREP_PATTERN_MAX 32
+
+#define OPT_INVERT 0x01
+#define OPT_COUNT 0x02
+#define OPT_ICASE 0x04
+#define OPT_NUMBER 0x08
+#define OPT_EXTENDED 0x10
+
+
+typedef struct
+{
+	unsigned char pat[GREP_PATTERN_MAX];
+	unsigned char fail[GREP_PATTERN_MAX];
+	unsigned char len;
+	unsigned char q;
+	bool icase;
+} grep_kmp_t;
+
+typedef union
+{
+	grep_kmp_t kmp;
+	regex_prog_t re;
+} grep_matcher_t;
+
+typedef struct
+{
+	unsigned char opts;
+	unsigned long line_no;
+	unsigned char hold[GREP_HOLD_SIZE];
+	unsigned char hold_len;
+	unsigned char* spill;
+	unsigned short spill_len;
+	bool truncated;
+	bool matched;
+	bool streaming;
+} grep_state_t;
+
+
+static bool parse_args(const char* str, unsigned char* opts, const char** pattern);
+static void kmp_init(grep_kmp_t* kmp, const char* pattern, bool icase);
+static bool kmp_step(grep_kmp_t* kmp, unsigned char c);
+static void begin_line(grep_state_t* st, grep_matcher_t* m);
+static void set_matched(grep_state_t* st);
+static void write_line_start(grep_state_t* st);
+static bool end_line(grep_state_t* st, grep_matcher_t* m);
 
-static bool parse_args(const char* str, char* s);
-static bool is_match(const char* line, const char* search);
 
 void grep_main(void* arg)
 {
 	const char* str = (const char*) arg;
-	unsigned char search[32];
+	const char* pattern;
+
+	grep_state_t st;
+	grep_matcher_t m;
 
-	if (!parse_args(str, search))
+	if (!parse_args(str, &st.opts, &pattern))
 	{
-		char buf[9];
-		sprintf(buf, "bad args");
-		serial_write(buf, strlen(buf));
+		serial_write_P(PSTR("bad args"));
+		serial_write_newline();
+
+		return;
+	}
+
+	const bool extended = ((st.opts & OPT_EXTENDED) != 0);
+	const bool icase = ((st.opts & OPT_ICASE) != 0);
+
+	if (!extended)
+	{
+		kmp_init(&m.kmp, pattern, icase);
+	}
+	else if (!regex_compile(&m.re, pattern, icase))
+	{
+		serial_write_P(PSTR("bad pattern"));
 		serial_write_newline();
 
 		return;
 	}
 
-	unsigned char line[64];
-	short i = 0;
+	st.line_no = 1;
+	st.spill = 0;
+	begin_line(&st, &m);
+
+	unsigned long count = 0;
+	unsigned char c;
 
 	while (true)
 	{
-		unsigned char c = serial_read_next_byte();
-		if (c == 0x03 || c == 0x04)
+		c = serial_read_next_byte();
+		if (c == 0x03)
 		{
 			break;
 		}
+		else if (c == 0x04)
+		{
+			// A last line without a line ending.
+			if (st.hold_len != 0 || st.truncated || st.streaming)
+			{
+				count += end_line(&st, &m);
+			}
+			break;
+		}
 		else if (c == 0x0a)
 		{
 			continue;
 		}
+		else if (c == 0x0d)
+		{
+			count += end_line(&st, &m);
+			begin_line(&st, &m);
+			continue;
+		}
 
-		line[i++] = c;
+		if (!st.matched)
+		{
+			if (extended ? regex_step(&m.re, c) : kmp_step(&m.kmp, c))
+			{
+				set_matched(&st);
+			}
+		}
+		else if (!st.streaming)
+		{
+			// Matched an empty string at the start of the line.
+			set_matched(&st);
+		}
 
-		if (c == 0x0d)
+		if (st.streaming)
+		{
+			serial_tx_byte(c);
+		}
+		else if (st.hold_len < GREP_HOLD_SIZE)
+		{
+			st.hold[st.hold_len++] = c;
+		}
+		else
 		{
-			line[i - 1] = 0x00;
-			if (is_match(line, search))
+			if (st.spill == 0)
 			{
-				serial_write(line, i);
-				serial_write_newline();
+				st.spill = rbuf_borrow(PSTR("grep"));
 			}
 
-			i = 0;
+			if (st.spill != 0 && st.spill_len < RBUF_SIZE)
+			{
+				st.spill[st.spill_len++] = c;
+			}
+			else
+			{
+				st.truncated = true;
+			}
 		}
 	}
+
+	if (st.spill != 0)
+	{
+		rbuf_give_back(st.spill);
+	}
+
+	if (c == 0x03)
+	{
+		return;
+	}
+
+	if ((st.opts & OPT_COUNT) != 0)
+	{
+		char buf[12];
+		sprintf_P(buf, PSTR("%lu"), count);
+		serial_write(buf, strlen(buf));
+		serial_write_newline();
+	}
 }
 
-static bool parse_args(const char* str, char* s)
+static bool parse_args(const char* str, unsigned char* opts, const char** pattern)
 {
 	str += 4; // Skip the "grep" command at the beginning.
 
-	// Next char must be a space.
-	if (*str != ' ')
-	{
-		return false;
-	}
+	*opts = 0;
 
-	// Skip all remaining spaces.
-	while ((*str) == ' ')
+	while (true)
 	{
-		str++;
+		// Next char must be a space.
+		if (*str != ' ')
+		{
+			return false;
+		}
+
+		// Skip all remaining spaces.
+		while ((*str) == ' ')
+		{
+			str++;
+		}
+
+		if (*str != '-')
+		{
+			break;
+		}
+
+		for (str++; *str != ' ' && *str != 0x00; str++)
+		{
+			switch (*str)
+			{
+			case 'v':
+				*opts |= OPT_INVERT;
+				break;
+			case 'c':
+				*opts |= OPT_COUNT;
+				break;
+			case 'i':
+				*opts |= OPT_ICASE;
+				break;
+			case 'n':
+				*opts |= OPT_NUMBER;
+				break;
+			case 'E':
+				*opts |= OPT_EXTENDED;
+				break;
+			default:
+				return false;
+			}
+		}
 	}
 
 	// Next char must not be null terminator.
-	if (*str == 0x00)
+	if (*str == 0x00 || strlen(str) >= GREP_PATTERN_MAX)
 	{
 		return false;
 	}
 
-	strcpy(s, str);
+	*pattern = str;
 
 	return true;
 }
 
-static bool is_match(const char* line, const char* search)
+static void kmp_init(grep_kmp_t* kmp, const char* pattern, bool icase)
 {
-	short lp = 0;
-	short sp = 0;
+	kmp->len = strlen(pattern);
+	kmp->q = 0;
+	kmp->icase = icase;
 
-	while (line[lp] != 0x00)
+	for (unsigned char i = 0; i < kmp->len; i++)
 	{
-		if (search[sp] == 0x00)
-		{
-			return true;
-		}
+		kmp->pat[i] = (icase ? util_to_lower(pattern[i]) : pattern[i]);
+	}
 
-		if (line[lp] == search[sp])
+	// fail[i] is the length of the longest proper prefix of pat[0..i] which is
+	// also a suffix of it.
+	kmp->fail[0] = 0;
+	unsigned char k = 0;
+	for (unsigned char i = 1; i < kmp->len; i++)
+	{
+		while (k > 0 && kmp->pat[i] != kmp->pat[k])
 		{
-			sp++;
+			k = kmp->fail[k - 1];
 		}
-		else
+
+		if (kmp->pat[i] == kmp->pat[k])
 		{
-			sp = 0;
+			k++;
 		}
 
-		lp++;
+		kmp->fail[i] = k;
+	}
+}
+
+// Returns true when the input so far ends with the pattern.
+static bool kmp_step(grep_kmp_t* kmp, unsigned char c)
+{
+	if (kmp->icase)
+	{
+		c = util_to_lower(c);
+	}
+
+	unsigned char q = kmp->q;
+	while (q > 0 && c != kmp->pat[q])
+	{
+		q = kmp->fail[q - 1];
+	}
+
+	if (c == kmp->pat[q])
+	{
+		q++;
 	}
 
-	if (search[sp] == 0x00)
+	if (q == kmp->len)
 	{
+		kmp->q = kmp->fail[q - 1];
 		return true;
 	}
 
+	kmp->q = q;
 	return false;
 }
+
+static void begin_line(grep_state_t* st, grep_matcher_t* m)
+{
+	st->hold_len = 0;
+	st->spill_len = 0;
+	st->truncated = false;
+	st->matched = false;
+	st->streaming = false;
+
+	if ((st->opts & OPT_EXTENDED) == 0)
+	{
+		m->kmp.q = 0;
+	}
+	else
+	{
+		// Lines are only printed once they have something in them.
+		st->matched = regex_begin_line(&m->re);
+	}
+}
+
+// Marks the line as matched, and starts streaming it out if it is to be printed.
+static void set_matched(grep_state_t* st)
+{
+	st->matched = true;
+
+	if ((st->opts & (OPT_INVERT | OPT_COUNT)) == 0)
+	{
+		write_line_start(st);
+		st->streaming = true;
+	}
+}
+
+static void write_line_start(grep_state_t* st)
+{
+	if ((st->opts & OPT_NUMBER) != 0)
+	{
+		char buf[12];
+		sprintf_P(buf, PSTR("%lu:"), st->line_no);
+		serial_write(buf, strlen(buf));
+	}
+
+	serial_write(st->hold, st->hold_len);
+
+	if (st->spill_len != 0)
+	{
+		serial_write(st->spill, st->spill_len);
+	}
+
+	if (st->truncated)
+	{
+		serial_write_P(PSTR("..."));
+	}
+}
+
+// Returns true if the line was selected.
+static bool end_line(grep_state_t* st, grep_matcher_t* m)
+{
+	// Only a regex ending in "$" can match right at the end of the line.
+	if (!st->matched && (st->opts & OPT_EXTENDED) != 0 && regex_end_line(&m->re))
+	{
+		st->matched = true;
+	}
+
+	const bool selected = (st->matched != ((st->opts & OPT_INVERT) != 0));
+
+	if (st->streaming)
+	{
+		serial_write_newline();
+	}
+	else if (selected && (st->opts & OPT_COUNT) == 0)
+	{
+		write_line_start(st);
+		serial_write_newline();
+	}
+
+	st->line_no++;
+
+	return selected;
+}
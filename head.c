@@ -0,0 +1,108 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "head.h"
+
+#include "serial.h"
+#include "util.h"
+
+// Returns as soon as the last line is written. In a pipe, the first command's
+// output is then dropped, and producers which check thread_is_pipe_closed()
+// (like "seq") stop early.
+
+#define HEAD_DEFAULT_LINES 10
+
+
+static bool parse_args(const char* str, unsigned short* n);
+
+
+void head_main(void* arg)
+{
+	const char* str = (const char*) arg;
+	unsigned short n;
+
+	if (!parse_args(str, &n))
+	{
+		serial_write_P(PSTR("bad args"));
+		serial_write_newline();
+
+		return;
+	}
+
+	bool in_line = false;
+
+	while (n != 0)
+	{
+		unsigned char c = serial_read_next_byte();
+		if (c == 0x03)
+		{
+			return;
+		}
+		else if (c == 0x04)
+		{
+			// A last line without a line ending.
+			if (in_line)
+			{
+				serial_write_newline();
+			}
+			return;
+		}
+		else if (c == 0x0a)
+		{
+			continue;
+		}
+		else if (c == 0x0d)
+		{
+			serial_write_newline();
+			in_line = false;
+			n--;
+			continue;
+		}
+
+		serial_tx_byte(c);
+		in_line = true;
+	}
+}
+
+static bool parse_args(const char* str, unsigned short* n)
+{
+	str += 4; // Skip the "head" command at the beginning.
+
+	*n = HEAD_DEFAULT_LINES;
+
+	// Skip all spaces.
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (*str == 0x00)
+	{
+		return true;
+	}
+
+	if (str[0] != '-' || str[1] != 'n' || str[2] != ' ')
+	{
+		return false;
+	}
+	str += 3;
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (!util_parse_u16(&str, n))
+	{
+		return false;
+	}
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	return (*str == 0x00);
+}
@@ -0,0 +1,6 @@
+#ifndef _HEAD_H_
+#define _HEAD_H_
+
+void head_main(void* arg);
+
+#endif // _HEAD_H_
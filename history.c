@@ -0,0 +1,269 @@
+#include <string.h>
+
+#include "history.h"
+
+#include "avr_mcu.h"
+#include "ee.h"
+
+// Commands are packed end-to-end into a byte ring, each followed by a null
+// terminator. Free bytes hold 0xff, and at least one free byte is always kept,
+// so the newest entry ends where the run of free bytes begins and the oldest
+// entry starts where it ends. This means no separate header needs to be kept,
+// and the EEPROM copy is written byte-by-byte as the ring advances, spreading
+// wear evenly across the whole region.
+
+#define HISTORY_FREE 0xff
+
+static unsigned char _ring[HISTORY_BUF_SIZE];
+static unsigned short _head = 0;
+static unsigned short _tail = 0;
+static unsigned short _free = HISTORY_BUF_SIZE;
+static unsigned short _count = 0;
+static unsigned short _last_number = 0;
+
+
+static void ring_store(unsigned short pos, unsigned char c);
+static void ring_clear();
+static bool ring_load();
+static void drop_oldest();
+static short entry_start(unsigned short back);
+static unsigned short ring_next(unsigned short pos);
+static unsigned short ring_prev(unsigned short pos);
+
+
+void history_init()
+{
+	if (!ring_load())
+	{
+		ring_clear();
+	}
+
+	_last_number = _count;
+}
+
+void history_add(const char* cmd)
+{
+	const unsigned short len = strlen(cmd);
+
+	// Need room for the terminator, plus the one free byte that is always kept.
+	if (len == 0 || len + 2 > HISTORY_BUF_SIZE)
+	{
+		return;
+	}
+
+	// Skip consecutive duplicates, which also avoids needless EEPROM writes.
+	short start = entry_start(0);
+	if (start >= 0)
+	{
+		unsigned short p = start;
+		unsigned short i = 0;
+		while (_ring[p] != 0 && cmd[i] == _ring[p])
+		{
+			p = ring_next(p);
+			i++;
+		}
+
+		if (_ring[p] == 0 && cmd[i] == 0)
+		{
+			return;
+		}
+	}
+
+	while (_free < len + 2)
+	{
+		drop_oldest();
+	}
+
+	for (unsigned short i = 0; i <= len; i++)
+	{
+		ring_store(_head, cmd[i]);
+		_head = ring_next(_head);
+	}
+
+	_free -= (len + 1);
+	_count++;
+	_last_number++;
+}
+
+unsigned short history_count()
+{
+	return _count;
+}
+
+unsigned short history_last_number()
+{
+	return _last_number;
+}
+
+bool history_get(unsigned short back, char* buf, unsigned short buf_size)
+{
+	short start = entry_start(back);
+	if (start < 0 || buf_size == 0)
+	{
+		return false;
+	}
+
+	unsigned short p = start;
+	unsigned short i = 0;
+	while (_ring[p] != 0 && i < buf_size - 1)
+	{
+		buf[i++] = _ring[p];
+		p = ring_next(p);
+	}
+	buf[i] = 0;
+
+	return true;
+}
+
+bool history_get_number(unsigned short n, char* buf, unsigned short buf_size)
+{
+	if (n > _last_number || n + _count <= _last_number)
+	{
+		return false;
+	}
+
+	return history_get(_last_number - n, buf, buf_size);
+}
+
+
+static void ring_store(unsigned short pos, unsigned char c)
+{
+	_ring[pos] = c;
+
+#ifdef HISTORY_EEPROM_SUPPORT
+	// Only rewritten if it actually changed.
+	ee_write(HISTORY_EEPROM_ADDR + pos, c);
+#endif
+}
+
+static void ring_clear()
+{
+	memset(_ring, HISTORY_FREE, HISTORY_BUF_SIZE);
+
+#ifdef HISTORY_EEPROM_SUPPORT
+	ee_write_block(_ring, HISTORY_EEPROM_ADDR, HISTORY_BUF_SIZE);
+#endif
+
+	_head = 0;
+	_tail = 0;
+	_free = HISTORY_BUF_SIZE;
+	_count = 0;
+}
+
+static bool ring_load()
+{
+#ifdef HISTORY_EEPROM_SUPPORT
+	ee_read_block(_ring, HISTORY_EEPROM_ADDR, HISTORY_BUF_SIZE);
+
+	unsigned short i;
+
+	_free = 0;
+	_count = 0;
+	for (i = 0; i < HISTORY_BUF_SIZE; i++)
+	{
+		const unsigned char c = _ring[i];
+		if (c == HISTORY_FREE)
+		{
+			_free++;
+		}
+		else if (c == 0)
+		{
+			_count++;
+		}
+		else if (c < 0x20 || c > 0x7e)
+		{
+			return false;
+		}
+	}
+
+	if (_free == 0)
+	{
+		return false;
+	}
+
+	if (_free == HISTORY_BUF_SIZE)
+	{
+		_head = 0;
+		_tail = 0;
+		return true;
+	}
+
+	// Find the start of the free run (the write position).
+	for (i = 0; i < HISTORY_BUF_SIZE; i++)
+	{
+		if (_ring[i] == HISTORY_FREE && _ring[ring_prev(i)] != HISTORY_FREE)
+		{
+			break;
+		}
+	}
+	_head = i;
+
+	// Discard a newest entry left unterminated by a power loss mid-write.
+	unsigned short p = ring_prev(_head);
+	while (_ring[p] != 0 && _ring[p] != HISTORY_FREE)
+	{
+		ring_store(p, HISTORY_FREE);
+		_free++;
+		_head = p;
+		p = ring_prev(p);
+	}
+
+	_tail = _head;
+	while (_ring[_tail] == HISTORY_FREE && _count > 0)
+	{
+		_tail = ring_next(_tail);
+	}
+
+	return (_free + _count <= HISTORY_BUF_SIZE);
+#else
+	return false;
+#endif
+}
+
+static void drop_oldest()
+{
+	while (_ring[_tail] != 0)
+	{
+		ring_store(_tail, HISTORY_FREE);
+		_tail = ring_next(_tail);
+		_free++;
+	}
+
+	ring_store(_tail, HISTORY_FREE);
+	_tail = ring_next(_tail);
+	_free++;
+	_count--;
+}
+
+// Returns the ring position of the entry "back" entries before the newest one.
+static short entry_start(unsigned short back)
+{
+	if (back >= _count)
+	{
+		return -1;
+	}
+
+	// Position of the terminator of the newest entry.
+	unsigned short p = ring_prev(_head);
+
+	for (unsigned short i = 0; i <= back; i++)
+	{
+		p = ring_prev(p);
+		while (_ring[p] != 0 && _ring[p] != HISTORY_FREE)
+		{
+			p = ring_prev(p);
+		}
+	}
+
+	return ring_next(p);
+}
+
+static unsigned short ring_next(unsigned short pos)
+{
+	return ((pos + 1) % HISTORY_BUF_SIZE);
+}
+
+static unsigned short ring_prev(unsigned short pos)
+{
+	return ((pos + HISTORY_BUF_SIZE - 1) % HISTORY_BUF_SIZE);
+}
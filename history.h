@@ -0,0 +1,13 @@
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include <stdbool.h>
+
+void history_init();
+void history_add(const char* cmd);
+unsigned short history_count();
+unsigned short history_last_number();
+bool history_get(unsigned short back, char* buf, unsigned short buf_size);
+bool history_get_number(unsigned short n, char* buf, unsigned short buf_size);
+
+#endif // _HISTORY_H_
@@ -0,0 +1,321 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "life.h"
+
+#include "avr_mcu.h"
+#include "fmt.h"
+#include "rng.h"
+#include "serial.h"
+#include "term.h"
+#include "timer.h"
+#include "util.h"
+
+// Conway's Life on a LIFE_WIDTH by LIFE_HEIGHT torus, kept as one bit per cell
+// in 16-bit words (bit 0 being the leftmost cell of each word). The neighbors
+// of all 16 cells in a word are added up at once, with bit-sliced adders over
+// the rows above and below and each row shifted by a column either way.
+//
+// Only the cells which changed in a step are drawn, found by XOR with the row
+// before the step. "life -q" leaves out the drawing, to time the steps alone.
+// Cells past the edge of the terminal are stepped but not drawn.
+
+#define LIFE_WORDS (LIFE_WIDTH >> 4)
+
+#if (LIFE_WIDTH & 0x0f) != 0
+	#error "LIFE_WIDTH must be a multiple of 16!"
+#endif
+
+// Longer than any gap which is written over rather than moved past.
+#define LIFE_WRITE_BUF_SIZE 16
+
+#define LIVE_C 'o'
+#define DEAD_C ' '
+
+// Assumed if the terminal doesn't report its size.
+#define LIFE_TERM_WIDTH 80
+#define LIFE_TERM_HEIGHT 24
+
+
+typedef unsigned short life_row_t[LIFE_WORDS];
+
+
+static unsigned char _draw_w;
+static unsigned char _draw_h;
+
+static bool parse_args(const char* str, bool* quiet, unsigned short* gens);
+static void get_draw_size();
+static void step(life_row_t* grid, bool draw);
+static void next_row(unsigned short* out, const unsigned short* above, const unsigned short* row, const unsigned short* below);
+static void draw_row(unsigned char y, const unsigned short* old, const unsigned short* row);
+static void write_report(unsigned long gens, unsigned long ticks, unsigned long bytes, bool quiet);
+
+
+void life_main(const char* str)
+{
+	bool quiet;
+	unsigned short gens;
+
+	if (!parse_args(str, &quiet, &gens))
+	{
+		serial_write_P(PSTR("bad args"));
+		serial_write_newline();
+
+		return;
+	}
+
+	// Start with about a quarter of the cells alive.
+	life_row_t grid[LIFE_HEIGHT];
+	for (unsigned char y = 0; y < LIFE_HEIGHT; y++)
+	{
+		for (unsigned char i = 0; i < LIFE_WORDS; i++)
+		{
+			grid[y][i] = rng_rand() & rng_rand();
+		}
+	}
+
+	if (!quiet)
+	{
+		get_draw_size();
+
+		term_set_cursor(false);
+		term_clear_screen();
+
+		life_row_t blank;
+		memset(blank, 0, sizeof(life_row_t));
+
+		for (unsigned char y = 0; y < _draw_h; y++)
+		{
+			draw_row(y, blank, grid[y]);
+		}
+	}
+
+	unsigned short t0[2];
+	unsigned short t1[2];
+	unsigned long n = 0;
+	unsigned long bytes = 0;
+
+	// Until the given number of generations, or any key.
+	timer_get_tick_count(t0);
+	while ((gens == 0 || n < gens) && !serial_has_next_byte())
+	{
+		const unsigned short tx = serial_get_tx_count();
+
+		step(grid, !quiet);
+		n++;
+
+		bytes += (unsigned short)(serial_get_tx_count() - tx);
+	}
+	timer_get_tick_count(t1);
+
+	if (serial_has_next_byte())
+	{
+		serial_read_next_byte();
+	}
+
+	if (!quiet)
+	{
+		term_clear_screen();
+		term_set_cursor(true);
+	}
+
+	const unsigned long ticks = ((((unsigned long)t1[0]) << 16) | t1[1]) - ((((unsigned long)t0[0]) << 16) | t0[1]);
+	write_report(n, ticks, bytes, quiet);
+}
+
+
+static bool parse_args(const char* str, bool* quiet, unsigned short* gens)
+{
+	str += 4; // Skip the "life" command at the beginning.
+
+	*quiet = false;
+	*gens = 0;
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (str[0] == '-' && str[1] == 'q' && (str[2] == ' ' || str[2] == 0x00))
+	{
+		*quiet = true;
+		str += 2;
+
+		while (*str == ' ')
+		{
+			str++;
+		}
+	}
+
+	if (*str != 0x00)
+	{
+		if (!util_parse_u16(&str, gens) || *gens == 0)
+		{
+			return false;
+		}
+
+		while (*str == ' ')
+		{
+			str++;
+		}
+	}
+
+	return (*str == 0x00);
+}
+
+static void get_draw_size()
+{
+	short w;
+	short h;
+	if (!term_get_size(&w, &h))
+	{
+		w = LIFE_TERM_WIDTH;
+		h = LIFE_TERM_HEIGHT;
+	}
+
+	// The last row is left for the cursor.
+	h--;
+
+	_draw_w = (w < LIFE_WIDTH ? w : LIFE_WIDTH);
+	_draw_h = (h < LIFE_HEIGHT ? h : LIFE_HEIGHT);
+}
+
+// Rows are worked out in place, so the old row above and the old first row
+// (for the last row) are kept aside.
+static void step(life_row_t* grid, bool draw)
+{
+	life_row_t first;
+	life_row_t above;
+	life_row_t out;
+
+	memcpy(first, grid[0], sizeof(life_row_t));
+	memcpy(above, grid[LIFE_HEIGHT - 1], sizeof(life_row_t));
+
+	for (unsigned char y = 0; y < LIFE_HEIGHT; y++)
+	{
+		const unsigned short* below = (y == LIFE_HEIGHT - 1 ? first : grid[y + 1]);
+		next_row(out, above, grid[y], below);
+
+		if (draw && y < _draw_h)
+		{
+			draw_row(y, grid[y], out);
+		}
+
+		memcpy(above, grid[y], sizeof(life_row_t));
+		memcpy(grid[y], out, sizeof(life_row_t));
+	}
+}
+
+static void next_row(unsigned short* out, const unsigned short* above, const unsigned short* row, const unsigned short* below)
+{
+	for (unsigned char i = 0; i < LIFE_WORDS; i++)
+	{
+		const unsigned char l = (i == 0 ? LIFE_WORDS - 1 : i - 1);
+		const unsigned char r = (i == LIFE_WORDS - 1 ? 0 : i + 1);
+
+		// Neighbors to the west and east, lined up with each cell.
+		const unsigned short aw = (above[i] << 1) | (above[l] >> 15);
+		const unsigned short ae = (above[i] >> 1) | (above[r] << 15);
+		const unsigned short mw = (row[i] << 1) | (row[l] >> 15);
+		const unsigned short me = (row[i] >> 1) | (row[r] << 15);
+		const unsigned short bw = (below[i] << 1) | (below[l] >> 15);
+		const unsigned short be = (below[i] >> 1) | (below[r] << 15);
+
+		// Each row's count (0-3, or 0-2 for the cell's own row) in two bit slices.
+		const unsigned short a0 = aw ^ above[i] ^ ae;
+		const unsigned short a1 = (aw & above[i]) | (ae & (aw ^ above[i]));
+		const unsigned short b0 = bw ^ below[i] ^ be;
+		const unsigned short b1 = (bw & below[i]) | (be & (bw ^ below[i]));
+		const unsigned short m0 = mw ^ me;
+		const unsigned short m1 = mw & me;
+
+		// The ones of the total, and the carry out of adding them.
+		const unsigned short ones = a0 ^ b0 ^ m0;
+		const unsigned short k = (a0 & b0) | (m0 & (a0 ^ b0));
+
+		// The total is 2 or 3 when exactly one of the twos (a1, b1, m1, k) is set.
+		const unsigned short p = a1 ^ b1;
+		const unsigned short q = m1 ^ k;
+		const unsigned short many = (a1 & b1) | (m1 & k) | (p & q);
+
+		out[i] = (p ^ q) & ~many & (ones | row[i]);
+	}
+}
+
+static void draw_row(unsigned char y, const unsigned short* old, const unsigned short* row)
+{
+	const short ty = y + 1;
+
+	for (unsigned char i = 0; i < LIFE_WORDS; i++)
+	{
+		const unsigned short diff = old[i] ^ row[i];
+		if (diff == 0)
+		{
+			continue;
+		}
+
+		for (unsigned char b = 0; b < 16; b++)
+		{
+			if ((diff & (1 << b)) == 0)
+			{
+				continue;
+			}
+
+			const short tx = (i << 4) + b + 1;
+			if (tx > _draw_w)
+			{
+				return;
+			}
+
+			char buf[LIFE_WRITE_BUF_SIZE];
+			unsigned char len = 0;
+
+			short x;
+			short cy;
+			if (term_get_cursor(&x, &cy) && cy == ty && x <= tx && tx - x < term_move_cost(tx, ty))
+			{
+				// The cells in between are unchanged, and shorter to write again than to move past.
+				for (; x < tx; x++)
+				{
+					buf[len++] = ((row[(x - 1) >> 4] & (1 << ((x - 1) & 0x0f))) ? LIVE_C : DEAD_C);
+				}
+			}
+			else
+			{
+				term_move_cursor(tx, ty);
+			}
+
+			buf[len++] = ((row[i] & (1 << b)) ? LIVE_C : DEAD_C);
+			term_write(buf, len);
+		}
+	}
+}
+
+static void write_report(unsigned long gens, unsigned long ticks, unsigned long bytes, bool quiet)
+{
+	// Generations per second, to one decimal place.
+	unsigned long r = 0;
+	if (ticks != 0)
+	{
+		r = (gens * TIMER_TICKS_PER_SECOND * 10 + (ticks >> 1)) / ticks;
+	}
+
+	char buf[FMT_U32_MAX_LEN];
+
+	serial_write_P(PSTR("gens "));
+	serial_write(buf, fmt_u32(buf, gens));
+	serial_write_P(PSTR(", per s "));
+	serial_write(buf, fmt_u32(buf, r / 10));
+	serial_tx_byte('.');
+	serial_write(buf, fmt_u16(buf, r % 10));
+
+	if (!quiet)
+	{
+		serial_write_P(PSTR(", bytes/gen "));
+		serial_write(buf, fmt_u32(buf, (gens == 0 ? 0 : bytes / gens)));
+	}
+
+	serial_write_newline();
+}
@@ -0,0 +1,6 @@
+#ifndef _LIFE_H_
+#define _LIFE_H_
+
+void life_main(const char* str);
+
+#endif // _LIFE_H_
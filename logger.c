@@ -0,0 +1,468 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "logger.h"
+
+#include "avr_mcu.h"
+#include "ee.h"
+#include "pm.h"
+#include "serial.h"
+#include "sp_mon.h"
+#include "thermal.h"
+#include "timer.h"
+#include "util.h"
+
+// Samples are appended to a byte ring in EEPROM, after a two-byte config word
+// holding the interval (0xffff when logging is off), so logging resumes after a
+// reset. Each record starts with a tag byte (bit 7 set) followed by 7-bit
+// payload bytes, so a record overwritten halfway by the ring wrapping around is
+// easy to skip over. The byte after the newest record is always 0xff, which is
+// how the write position is found again after a reset.
+//
+// Key record (8 bytes), written first and then every LOGGER_KEY_EVERY samples,
+// or whenever a sample does not fit into a delta record:
+//   [0] 0xc0 (0xc1 if the first record since logging started)
+//   [1] temperature + 40 (127 if not available)
+//   [2] load (0-127)
+//   [3..4] SP low-water mark / 8, high 7 bits first
+//   [5] RX bytes dropped since the last sample (saturated at 127)
+//   [6..7] interval in seconds, high 7 bits first
+//
+// Delta record (2 bytes), for samples without RX drops:
+//   [0] 10TT SSSS: temperature change (-2..1), SP low-water mark change / 8 (-8..7)
+//   [1] load
+
+#define LOGGER_DEFAULT_INTERVAL 60
+#define LOGGER_MAX_INTERVAL 0x3fff
+#define LOGGER_KEY_EVERY 32
+
+#define LOGGER_OFF 0xffff
+
+#define LOGGER_RING_ADDR (LOGGER_EEPROM_ADDR + 2)
+#define LOGGER_RING_SIZE (LOGGER_EEPROM_SIZE - 2)
+
+#define TAG_KEY 0xc0
+#define TAG_KEY_START 0xc1
+#define TAG_DELTA 0x80
+#define TAG_FREE 0xff
+
+#define KEY_LEN 8
+#define DELTA_LEN 2
+
+#define TEMP_OFFSET 40
+#define TEMP_NONE 127
+
+
+typedef struct
+{
+	unsigned char temp;
+	unsigned char load;
+	unsigned short sp;
+	unsigned char drops;
+} logger_sample_t;
+
+static timer_notify_t _notify;
+static unsigned short _interval = LOGGER_OFF;
+static unsigned short _pos = 0;
+
+static logger_sample_t _last;
+static unsigned char _since_key = 0;
+static bool _start = false;
+static unsigned short _rx_drops = 0;
+
+static unsigned short _samples = 0;
+static unsigned long _cycles = 0;
+
+
+static void start(unsigned short interval);
+static void stop();
+static void take_sample(logger_sample_t* s);
+static void write_sample(const logger_sample_t* s);
+static void ring_write(const unsigned char* rec, unsigned char len);
+static unsigned short ring_next(unsigned short pos, unsigned short n);
+static void dump();
+static void clear();
+static void status();
+static void write_msg(const char* msg);
+static void write_line(const char* buf);
+
+
+void logger_init()
+{
+	// Find the free byte which follows the newest record.
+	unsigned char prev = ee_read(LOGGER_RING_ADDR + LOGGER_RING_SIZE - 1);
+	for (unsigned short i = 0; i < LOGGER_RING_SIZE; i++)
+	{
+		const unsigned char c = ee_read(LOGGER_RING_ADDR + i);
+		if (c == TAG_FREE && prev != TAG_FREE)
+		{
+			_pos = i;
+			break;
+		}
+		prev = c;
+	}
+
+	unsigned short interval;
+	ee_read_block(&interval, LOGGER_EEPROM_ADDR, sizeof(interval));
+	if (interval != LOGGER_OFF && interval != 0 && interval <= LOGGER_MAX_INTERVAL)
+	{
+		start(interval);
+	}
+}
+
+// Called when the CPU would otherwise be idle.
+void logger_poll()
+{
+	if (_interval == LOGGER_OFF || !_notify.notify)
+	{
+		return;
+	}
+
+	const unsigned long c0 = timer_get_cycles();
+
+	// Keep a steady cadence, unless sampling fell behind by a whole interval.
+	unsigned short t[2];
+	timer_get_tick_count(t);
+	timer_add_seconds(_notify.t, _interval);
+	if (timer_compare(_notify.t, t) <= 0)
+	{
+		_notify.t[0] = t[0];
+		_notify.t[1] = t[1];
+		timer_add_seconds(_notify.t, _interval);
+	}
+
+	// Registering again first also keeps this from being re-entered through
+	// pm_yield() if the EEPROM write queue is full.
+	if (!timer_notify_register(&_notify))
+	{
+		_interval = LOGGER_OFF;
+		return;
+	}
+
+	logger_sample_t s;
+	take_sample(&s);
+	write_sample(&s);
+
+	_samples++;
+	_cycles += (timer_get_cycles() - c0);
+}
+
+void logger_main(const char* str)
+{
+	str += 3; // Skip the "log" command at the beginning.
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (*str == 0x00)
+	{
+		status();
+	}
+	else if (strncmp_P(str, PSTR("on"), 2) == 0)
+	{
+		str += 2;
+		while (*str == ' ')
+		{
+			str++;
+		}
+
+		unsigned short interval = 0;
+		while (util_is_numeric(*str))
+		{
+			interval = interval * 10 + (*str - '0');
+			str++;
+		}
+
+		if (interval == 0)
+		{
+			interval = LOGGER_DEFAULT_INTERVAL;
+		}
+
+		if (*str != 0x00 || interval > LOGGER_MAX_INTERVAL)
+		{
+			write_msg(PSTR("bad args"));
+			return;
+		}
+
+		stop();
+		ee_write_block(&interval, LOGGER_EEPROM_ADDR, sizeof(interval));
+		start(interval);
+	}
+	else if (strcmp_P(str, PSTR("off")) == 0)
+	{
+		stop();
+
+		const unsigned short interval = LOGGER_OFF;
+		ee_write_block(&interval, LOGGER_EEPROM_ADDR, sizeof(interval));
+	}
+	else if (strcmp_P(str, PSTR("dump")) == 0)
+	{
+		dump();
+	}
+	else if (strcmp_P(str, PSTR("clear")) == 0)
+	{
+		clear();
+	}
+	else
+	{
+		write_msg(PSTR("bad args"));
+	}
+}
+
+
+static void start(unsigned short interval)
+{
+	_interval = interval;
+	_since_key = 0;
+	_start = true;
+	_rx_drops = serial_get_rx_drop_count();
+	sp_mon_take_low_water();
+
+	timer_get_tick_count(_notify.t);
+	timer_add_seconds(_notify.t, _interval);
+	if (!timer_notify_register(&_notify))
+	{
+		_interval = LOGGER_OFF;
+		write_msg(PSTR("no timer"));
+	}
+}
+
+static void stop()
+{
+	if (_interval != LOGGER_OFF)
+	{
+		timer_notify_unregister(&_notify);
+		_interval = LOGGER_OFF;
+	}
+}
+
+static void take_sample(logger_sample_t* s)
+{
+	const short temp = thermal_read_temperature();
+	if (temp == THERMAL_TEMP_NONE)
+	{
+		s->temp = TEMP_NONE;
+	}
+	else if (temp < -TEMP_OFFSET)
+	{
+		s->temp = 0;
+	}
+	else if (temp >= TEMP_NONE - TEMP_OFFSET)
+	{
+		s->temp = TEMP_NONE - 1;
+	}
+	else
+	{
+		s->temp = temp + TEMP_OFFSET;
+	}
+
+	// 0x0ff0 is the most wake ticks there can be, so this gives 0-127.
+	unsigned short w[2];
+	pm_get_wake_count(w);
+	s->load = (w[0] >> 5);
+
+	s->sp = (sp_mon_take_low_water() >> 3);
+
+	const unsigned short drops = serial_get_rx_drop_count();
+	const unsigned short new_drops = drops - _rx_drops;
+	_rx_drops = drops;
+	s->drops = (new_drops > 0x7f ? 0x7f : new_drops);
+}
+
+static void write_sample(const logger_sample_t* s)
+{
+	const short dt = (short)s->temp - _last.temp;
+	const short dsp = (short)s->sp - (short)_last.sp;
+
+	if (!_start && _since_key != LOGGER_KEY_EVERY && s->drops == 0 &&
+		dt >= -2 && dt <= 1 && dsp >= -8 && dsp <= 7)
+	{
+		unsigned char rec[DELTA_LEN];
+		rec[0] = TAG_DELTA | ((dt & 0x03) << 4) | (dsp & 0x0f);
+		rec[1] = s->load;
+
+		ring_write(rec, DELTA_LEN);
+		_since_key++;
+	}
+	else
+	{
+		unsigned char rec[KEY_LEN];
+		rec[0] = (_start ? TAG_KEY_START : TAG_KEY);
+		rec[1] = s->temp;
+		rec[2] = s->load;
+		rec[3] = ((s->sp >> 7) & 0x7f);
+		rec[4] = (s->sp & 0x7f);
+		rec[5] = s->drops;
+		rec[6] = ((_interval >> 7) & 0x7f);
+		rec[7] = (_interval & 0x7f);
+
+		ring_write(rec, KEY_LEN);
+		_since_key = 0;
+		_start = false;
+	}
+
+	_last = *s;
+}
+
+static void ring_write(const unsigned char* rec, unsigned char len)
+{
+	for (unsigned char i = 0; i < len; i++)
+	{
+		ee_write(LOGGER_RING_ADDR + _pos, rec[i]);
+		_pos = ring_next(_pos, 1);
+	}
+
+	ee_write(LOGGER_RING_ADDR + _pos, TAG_FREE);
+}
+
+static unsigned short ring_next(unsigned short pos, unsigned short n)
+{
+	pos += n;
+	return (pos >= LOGGER_RING_SIZE ? pos - LOGGER_RING_SIZE : pos);
+}
+
+static void dump()
+{
+	char buf[48];
+	unsigned char rec[KEY_LEN];
+
+	logger_sample_t s;
+	unsigned short interval = 0;
+	unsigned long t = 0;
+	bool have_key = false;
+
+	// The oldest record follows the free byte(s) after the newest one.
+	unsigned short pos = ring_next(_pos, 1);
+	unsigned short left = LOGGER_RING_SIZE - 1;
+
+	while (left != 0)
+	{
+		rec[0] = ee_read(LOGGER_RING_ADDR + pos);
+
+		const unsigned char len = ((rec[0] & 0xc0) == TAG_KEY ? KEY_LEN : DELTA_LEN);
+		if (rec[0] == TAG_FREE || (rec[0] & 0x80) == 0 || len > left)
+		{
+			// Free, or the tail end of an overwritten record.
+			pos = ring_next(pos, 1);
+			left--;
+			continue;
+		}
+
+		for (unsigned char i = 1; i < len; i++)
+		{
+			rec[i] = ee_read(LOGGER_RING_ADDR + ring_next(pos, i));
+		}
+		pos = ring_next(pos, len);
+		left -= len;
+
+		if (len == KEY_LEN)
+		{
+			s.temp = rec[1];
+			s.load = rec[2];
+			s.sp = ((unsigned short)rec[3] << 7) | rec[4];
+			s.drops = rec[5];
+			interval = ((unsigned short)rec[6] << 7) | rec[7];
+
+			if (rec[0] == TAG_KEY_START || !have_key)
+			{
+				t = 0;
+				sprintf_P(buf, PSTR("-- %Severy %u s"), (rec[0] == TAG_KEY_START ? PSTR("start, ") : PSTR("")), interval);
+				write_line(buf);
+			}
+			else
+			{
+				t += interval;
+			}
+
+			have_key = true;
+		}
+		else if (have_key)
+		{
+			// Sign-extend the 2-bit and 4-bit deltas.
+			s.temp += (((rec[0] >> 4) & 0x03) ^ 0x02) - 2;
+			s.sp += ((rec[0] & 0x0f) ^ 0x08) - 8;
+			s.load = rec[1];
+			s.drops = 0;
+			t += interval;
+		}
+		else
+		{
+			continue;
+		}
+
+		sprintf_P(buf, PSTR("%7lu "), t);
+		serial_write(buf, strlen(buf));
+
+		if (s.temp == TEMP_NONE)
+		{
+			sprintf_P(buf, PSTR("   - C"));
+		}
+		else
+		{
+			sprintf_P(buf, PSTR("%4d C"), (short)s.temp - TEMP_OFFSET);
+		}
+		serial_write(buf, strlen(buf));
+
+		sprintf_P(buf, PSTR("  load %3u%%  sp 0x%04x  rx %u"), (s.load * 100) / 127, s.sp << 3, s.drops);
+		write_line(buf);
+	}
+}
+
+static void clear()
+{
+	for (unsigned short i = 0; i < LOGGER_RING_SIZE; i++)
+	{
+		ee_write(LOGGER_RING_ADDR + i, TAG_FREE);
+	}
+
+	_pos = 0;
+	_start = true;
+}
+
+static void status()
+{
+	char buf[48];
+
+	if (_interval == LOGGER_OFF)
+	{
+		write_msg(PSTR("off"));
+	}
+	else
+	{
+		sprintf_P(buf, PSTR("every %u s"), _interval);
+		write_line(buf);
+	}
+
+	sprintf_P(buf, PSTR("samples: %u"), _samples);
+	write_line(buf);
+
+	if (_samples != 0)
+	{
+		// Time spent sampling, excluding the EEPROM programming interrupts.
+		const unsigned long us = _cycles / _samples / (F_CPU / 1000000);
+		sprintf_P(buf, PSTR("cost: %lu us/sample"), us);
+		write_line(buf);
+
+		if (_interval != LOGGER_OFF)
+		{
+			sprintf_P(buf, PSTR("CPU: %lu ppm"), us / _interval);
+			write_line(buf);
+		}
+	}
+}
+
+static void write_msg(const char* msg)
+{
+	serial_write_P(msg);
+	serial_write_newline();
+}
+
+static void write_line(const char* buf)
+{
+	serial_write(buf, strlen(buf));
+	serial_write_newline();
+}
@@ -0,0 +1,8 @@
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+void logger_init();
+void logger_poll();
+void logger_main(const char* str);
+
+#endif // _LOGGER_H_
@@ -0,0 +1,307 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "lz.h"
+
+#include "avr_mcu.h"
+#include "fmt.h"
+#include "rbuf.h"
+#include "serial.h"
+
+// Compressed output ("lz on"): everything which would go to the USART through
+// serial_tx_byte() is LZSS-encoded first, in the style of heatshrink, and
+// tools/lzcat.py decodes it on the host.
+//
+// The stream starts with the raw bytes ESC 'L' 'Z'. After that it is a string
+// of bits, most significant bit first:
+//   1 cccccccc                   literal byte c
+//   0 d(LZ_WINDOW_BITS) n(LZ_LENGTH_BITS)
+//                                copy n + LZ_MIN_MATCH bytes from d bytes back
+// A distance of 0 is a marker rather than a copy: n = 0 is a flush (the rest of
+// the byte is padding), and n = 1 ends the stream (also followed by padding),
+// after which output is raw again.
+//
+// The last LZ_WINDOW_SIZE bytes written are kept in a ring, which is searched
+// for the longest match at each position. The ring is a RAM buffer (see rbuf.c)
+// borrowed for as long as compression is on, so "lz on" needs one to be free. Nothing is sent until a full match
+// length of input is waiting, or until the CPU is about to go idle, which is
+// when pm_yield() calls lz_flush().
+
+#define LZ_WINDOW_SIZE (1 << LZ_WINDOW_BITS)
+
+#if (LZ_WINDOW_SIZE > RBUF_SIZE)
+	#error "LZ window larger than a RAM buffer!"
+#endif
+#define LZ_MASK (LZ_WINDOW_SIZE - 1)
+#define LZ_MIN_MATCH 2
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + (1 << LZ_LENGTH_BITS) - 1)
+
+// Matches never reach further back than this, so the bytes waiting to be
+// encoded can never have overwritten any byte a match uses.
+#define LZ_MAX_DISTANCE (LZ_WINDOW_SIZE - LZ_MAX_MATCH)
+
+#define MARK_FLUSH 0
+#define MARK_END 1
+
+
+static unsigned char* _ring;
+
+// Positions in the stream of input, modulo 2^16.
+static unsigned short _head;
+static unsigned short _pos;
+
+// How far back a match can currently reach.
+static unsigned short _hist;
+
+static unsigned char _bits;
+static unsigned char _bit_count;
+
+static bool _on = false;
+static bool _unflushed;
+
+static unsigned long _in_count;
+static unsigned long _out_count;
+
+
+static void encode_next();
+static void put_bits(unsigned short v, unsigned char n);
+static void put_marker(unsigned char n);
+static void status();
+static void write_msg(const char* msg);
+
+
+void lz_main(const char* str)
+{
+	str += 2; // Skip the "lz" command at the beginning.
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (*str == 0x00)
+	{
+		status();
+	}
+	else if (strcmp_P(str, PSTR("on")) == 0)
+	{
+		// The stream's start and markers go straight to the USART, which would
+		// break up machine mode's frames or end up apart from redirected output.
+		if (serial_get_tx_hook() != 0)
+		{
+			write_msg(PSTR("invalid"));
+		}
+		else if (!lz_on())
+		{
+			write_msg(PSTR("no free buffer"));
+		}
+	}
+	else if (strcmp_P(str, PSTR("off")) == 0)
+	{
+		lz_off();
+	}
+	else
+	{
+		write_msg(PSTR("bad args"));
+	}
+}
+
+// Returns false if there is no RAM buffer free for the window.
+bool lz_on()
+{
+	if (_on)
+	{
+		return true;
+	}
+
+	_ring = rbuf_borrow(PSTR("lz"));
+	if (_ring == 0)
+	{
+		return false;
+	}
+
+	serial_tx_byte_direct('\e');
+	serial_tx_byte_direct('L');
+	serial_tx_byte_direct('Z');
+
+	_head = 0;
+	_pos = 0;
+	_hist = 0;
+	_bits = 0;
+	_bit_count = 0;
+	_unflushed = false;
+	_in_count = 0;
+	_out_count = 0;
+
+	_on = true;
+
+	return true;
+}
+
+void lz_off()
+{
+	if (!_on)
+	{
+		return;
+	}
+
+	while (_head != _pos)
+	{
+		encode_next();
+	}
+	put_marker(MARK_END);
+
+	rbuf_give_back(_ring);
+	_on = false;
+}
+
+bool lz_is_on()
+{
+	return _on;
+}
+
+void lz_write(unsigned char c)
+{
+	_ring[_head & LZ_MASK] = c;
+	_head++;
+	_in_count++;
+
+	if ((unsigned short)(_head - _pos) == LZ_MAX_MATCH)
+	{
+		encode_next();
+	}
+}
+
+// Sends everything written so far, so that the host is not left waiting for it.
+void lz_flush()
+{
+	if (!_on)
+	{
+		return;
+	}
+
+	while (_head != _pos)
+	{
+		encode_next();
+	}
+
+	if (_unflushed)
+	{
+		put_marker(MARK_FLUSH);
+		_unflushed = false;
+	}
+}
+
+
+static void encode_next()
+{
+	const unsigned char avail = (_head - _pos);
+	unsigned char best_len = 0;
+	unsigned short best_dist = 0;
+
+	if (avail >= LZ_MIN_MATCH)
+	{
+		const unsigned char c0 = _ring[_pos & LZ_MASK];
+		const unsigned char c1 = _ring[(_pos + 1) & LZ_MASK];
+
+		for (unsigned short d = 1; d <= _hist; d++)
+		{
+			const unsigned short p = _pos - d;
+
+			if (_ring[p & LZ_MASK] != c0 || _ring[(p + 1) & LZ_MASK] != c1)
+			{
+				continue;
+			}
+
+			unsigned char len = LZ_MIN_MATCH;
+			while (len < avail && _ring[(p + len) & LZ_MASK] == _ring[(_pos + len) & LZ_MASK])
+			{
+				len++;
+			}
+
+			if (len > best_len)
+			{
+				best_len = len;
+				best_dist = d;
+
+				if (len == avail)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	unsigned char n;
+	if (best_len >= LZ_MIN_MATCH)
+	{
+		put_bits(0, 1);
+		put_bits(best_dist, LZ_WINDOW_BITS);
+		put_bits(best_len - LZ_MIN_MATCH, LZ_LENGTH_BITS);
+		n = best_len;
+	}
+	else
+	{
+		put_bits(0x100 | _ring[_pos & LZ_MASK], 9);
+		n = 1;
+	}
+
+	_pos += n;
+	_hist = (_hist + n > LZ_MAX_DISTANCE ? LZ_MAX_DISTANCE : _hist + n);
+	_unflushed = true;
+}
+
+static void put_bits(unsigned short v, unsigned char n)
+{
+	while (n != 0)
+	{
+		n--;
+		_bits = (_bits << 1) | ((v >> n) & 0x01);
+
+		if (++_bit_count == 8)
+		{
+			serial_tx_byte_direct(_bits);
+			_out_count++;
+			_bit_count = 0;
+		}
+	}
+}
+
+static void put_marker(unsigned char n)
+{
+	put_bits(0, 1 + LZ_WINDOW_BITS);
+	put_bits(n, LZ_LENGTH_BITS);
+
+	if (_bit_count != 0)
+	{
+		put_bits(0, 8 - _bit_count);
+	}
+}
+
+static void status()
+{
+	if (!_on)
+	{
+		write_msg(PSTR("off"));
+		return;
+	}
+
+	// Counted before this message, which is still being compressed.
+	const unsigned long in = _in_count;
+	const unsigned long out = _out_count;
+
+	char buf[FMT_U32_MAX_LEN];
+
+	serial_write_P(PSTR("on, in "));
+	serial_write(buf, fmt_u32(buf, in));
+	serial_write_P(PSTR(" out "));
+	serial_write(buf, fmt_u32(buf, out));
+	serial_write_newline();
+}
+
+static void write_msg(const char* msg)
+{
+	serial_write_P(msg);
+	serial_write_newline();
+}
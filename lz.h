@@ -0,0 +1,13 @@
+#ifndef _LZ_H_
+#define _LZ_H_
+
+#include <stdbool.h>
+
+void lz_main(const char* str);
+bool lz_on();
+void lz_off();
+bool lz_is_on();
+void lz_write(unsigned char c);
+void lz_flush();
+
+#endif // _LZ_H_
@@ -0,0 +1,237 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <util/crc16.h>
+
+#include "machine.h"
+
+#include "command.h"
+#include "lz.h"
+#include "serial.h"
+
+// Machine mode: a framed request/response protocol for automated hosts, with no
+// echo, prompts or VT100 sequences.
+//
+// Both directions use SLIP framing (RFC 1055): each frame ends with 0xc0, and
+// 0xc0/0xdb inside a frame are sent as 0xdb 0xdc/0xdb 0xdd.
+//
+// Request:  [seq] [command...] [CRC lo] [CRC hi]
+// Response: [seq] [output...] [status] [CRC lo] [CRC hi]
+//
+// The CRC is CRC-16/MCRF4XX (avr-libc's _crc_ccitt_update() starting from
+// 0xffff) over everything before it. The response is streamed as the command
+// runs, which is why the status comes after the output. Requests may be sent
+// without waiting for responses, up to SERIAL_RX_BUF_SIZE bytes ahead.
+//
+// The "exit" command leaves machine mode.
+
+#define MACHINE_CMD_MAX 64
+#define MACHINE_FRAME_MAX (1 + MACHINE_CMD_MAX + 2)
+
+#define SLIP_END 0xc0
+#define SLIP_ESC 0xdb
+#define SLIP_ESC_END 0xdc
+#define SLIP_ESC_ESC 0xdd
+
+#define STATUS_OK 0x00
+#define STATUS_BAD_CRC 0x01
+#define STATUS_TOO_LONG 0x02
+#define STATUS_EXIT 0x03
+
+
+static unsigned short _crc;
+static bool _vt100_esc;
+
+
+static short read_frame(unsigned char* frame);
+static char run_frame(unsigned char* frame, short len);
+static void response_begin(unsigned char seq);
+static void response_end(unsigned char status);
+static void response_byte(unsigned char c);
+static void output_byte(unsigned char c);
+static void slip_tx_byte(unsigned char c);
+
+
+char machine_main()
+{
+	if (serial_get_tx_hook() != 0 || serial_get_rx_hook() != 0)
+	{
+		return 0;
+	}
+
+	unsigned char frame[MACHINE_FRAME_MAX];
+
+	// Frames are written straight to the USART, so end any compressed output.
+	lz_off();
+
+	// Lets the host discard anything received before the first frame.
+	serial_tx_byte_direct(SLIP_END);
+
+	while (true)
+	{
+		const short len = read_frame(frame);
+		if (len == 0)
+		{
+			continue;
+		}
+
+		const char rc = run_frame(frame, len);
+		if (rc != 0)
+		{
+			return (rc > 0 ? 0 : rc);
+		}
+	}
+}
+
+
+// Returns the frame length, or -1 if the frame did not fit.
+static short read_frame(unsigned char* frame)
+{
+	short len = 0;
+	bool esc = false;
+
+	while (true)
+	{
+		unsigned char c = serial_read_next_byte();
+
+		if (c == SLIP_END)
+		{
+			return len;
+		}
+
+		if (c == SLIP_ESC)
+		{
+			esc = true;
+			continue;
+		}
+
+		if (esc)
+		{
+			esc = false;
+			if (c == SLIP_ESC_END)
+			{
+				c = SLIP_END;
+			}
+			else if (c == SLIP_ESC_ESC)
+			{
+				c = SLIP_ESC;
+			}
+		}
+
+		if (len < 0 || len == MACHINE_FRAME_MAX)
+		{
+			// Keep dropping bytes until the end of the frame.
+			len = -1;
+		}
+		else
+		{
+			frame[len++] = c;
+		}
+	}
+}
+
+// Returns 1 for "exit", or the command's return code if it was a reset or stop.
+static char run_frame(unsigned char* frame, short len)
+{
+	if (len < 0)
+	{
+		response_begin(0);
+		response_end(STATUS_TOO_LONG);
+		return 0;
+	}
+
+	unsigned short crc = 0xffff;
+	for (short i = 0; i < len - 2; i++)
+	{
+		crc = _crc_ccitt_update(crc, frame[i]);
+	}
+
+	if (len < 3 || frame[len - 2] != (crc & 0xff) || frame[len - 1] != (crc >> 8))
+	{
+		response_begin(frame[0]);
+		response_end(STATUS_BAD_CRC);
+		return 0;
+	}
+
+	unsigned char* cmd = frame + 1;
+	cmd[len - 3] = 0x00;
+
+	response_begin(frame[0]);
+
+	if (strcmp_P((const char*)cmd, PSTR("exit")) == 0)
+	{
+		response_end(STATUS_OK);
+		return 1;
+	}
+
+	serial_set_tx_hook(&output_byte);
+	const char rc = command_process(cmd);
+	serial_set_tx_hook(0);
+
+	response_end(rc < 0 ? STATUS_EXIT : STATUS_OK);
+
+	return rc;
+}
+
+static void response_begin(unsigned char seq)
+{
+	_crc = 0xffff;
+	_vt100_esc = false;
+
+	response_byte(seq);
+}
+
+static void response_end(unsigned char status)
+{
+	response_byte(status);
+
+	const unsigned short crc = _crc;
+	slip_tx_byte(crc & 0xff);
+	slip_tx_byte(crc >> 8);
+
+	serial_tx_byte_direct(SLIP_END);
+}
+
+static void response_byte(unsigned char c)
+{
+	_crc = _crc_ccitt_update(_crc, c);
+	slip_tx_byte(c);
+}
+
+// TX hook for command output, which drops any VT100 escape sequences.
+static void output_byte(unsigned char c)
+{
+	if (_vt100_esc)
+	{
+		if (c >= 0x40 && c <= 0x7e && c != '[')
+		{
+			_vt100_esc = false;
+		}
+		return;
+	}
+
+	if (c == 0x1b)
+	{
+		_vt100_esc = true;
+		return;
+	}
+
+	response_byte(c);
+}
+
+static void slip_tx_byte(unsigned char c)
+{
+	if (c == SLIP_END)
+	{
+		serial_tx_byte_direct(SLIP_ESC);
+		serial_tx_byte_direct(SLIP_ESC_END);
+	}
+	else if (c == SLIP_ESC)
+	{
+		serial_tx_byte_direct(SLIP_ESC);
+		serial_tx_byte_direct(SLIP_ESC_ESC);
+	}
+	else
+	{
+		serial_tx_byte_direct(c);
+	}
+}
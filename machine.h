@@ -0,0 +1,6 @@
+#ifndef _MACHINE_H_
+#define _MACHINE_H_
+
+char machine_main();
+
+#endif // _MACHINE_H_
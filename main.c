@@ -1,22 +1,33 @@
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <stdbool.h>
 #include <string.h>
 
 #include "command.h"
+#include "ee.h"
+#include "eefs.h"
+#include "history.h"
 #include "led.h"
+#include "logger.h"
+#include "lz.h"
+#include "script.h"
 #include "serial.h"
 #include "thermal.h"
 #include "timer.h"
+#include "util.h"
 
 #define CMD_BUF_SIZE 32
 
-static const unsigned char* GREETING_1 = "Welcome to avrsysh!";
-static const unsigned char* GREETING_2 = "Enter command:";
-static const unsigned char* PROMPT = "> ";
+static const char GREETING_1[] PROGMEM = "Welcome to avrsysh!";
+static const char GREETING_2[] PROGMEM = "Enter command:";
+static const char PROMPT[] PROGMEM = "> ";
 static const unsigned char BACKSPACE[6] = { 0x1b, '[', 'D', 0x1b, '[', 'K' };
+static const char HISTORY_NOT_FOUND[] PROGMEM = "!: event not found";
 
 static void reset(void);
 static short loop(void);
+static void replace_buf(unsigned char* buf, short* buf_i, const unsigned char* s);
+static bool expand_history(unsigned char* buf);
  
 void main(void)
 {
@@ -27,13 +38,25 @@ void main(void)
 
 	sei();
 
+	// These may queue EEPROM writes (e.g. clearing a history ring which doesn't
+	// check out), which are only written from the EE_READY interrupt.
+	history_init();
+	eefs_init();
+	logger_init();
+
 	serial_write_newline();
-	serial_write(GREETING_1, strlen(GREETING_1));
+	serial_write_P(GREETING_1);
 	serial_write_newline();
-	serial_write(GREETING_2, strlen(GREETING_2));
+	serial_write_P(GREETING_2);
 	serial_write_newline();
 
-	if (loop() == PC_RC_RESET)
+	short rc = script_autorun();
+	if (rc == 0)
+	{
+		rc = loop();
+	}
+
+	if (rc == PC_RC_RESET)
 	{
 		reset();
 	}
@@ -41,6 +64,10 @@ void main(void)
 
 static void reset(void)
 {
+	// Let any queued EEPROM writes finish first, and end compressed output.
+	ee_flush();
+	lz_off();
+
 	asm volatile (
 		"cli\r\n" \
 		"jmp 0\r\n"
@@ -50,14 +77,15 @@ static void reset(void)
 static short loop(void)
 {
 	unsigned char buf[CMD_BUF_SIZE];
-	unsigned char last_cmd[CMD_BUF_SIZE];
 	short buf_i = 0;
 	bool esc = false;
 
-	serial_write(PROMPT, strlen(PROMPT));
+	// Number of entries back in history currently being shown (0 if none).
+	unsigned short hist_pos = 0;
+
+	serial_write_P(PROMPT);
 
 	memset(buf, 0, CMD_BUF_SIZE);
-	memset(last_cmd, 0, CMD_BUF_SIZE);
 
 	while (1)
 	{
@@ -72,16 +100,24 @@ static short loop(void)
 
 			if (c == 'A')
 			{
-				// First, erase anything currently in the command buffer.
-				short back = strlen(buf);
-				for (short i = 0; i < back; i++)
+				unsigned char hist[CMD_BUF_SIZE];
+				if (history_get(hist_pos, hist, CMD_BUF_SIZE))
 				{
-					serial_write(BACKSPACE, sizeof(BACKSPACE));
+					hist_pos++;
+					replace_buf(buf, &buf_i, hist);
 				}
+			}
+			else if (c == 'B' && hist_pos != 0)
+			{
+				unsigned char hist[CMD_BUF_SIZE];
+				hist[0] = 0;
 
-				strcpy(buf, last_cmd);
-				serial_write(buf, strlen(buf));
-				buf_i = strlen(buf);
+				hist_pos--;
+				if (hist_pos != 0)
+				{
+					history_get(hist_pos - 1, hist, CMD_BUF_SIZE);
+				}
+				replace_buf(buf, &buf_i, hist);
 			}
 		}
 		else if (c == 0x08 || c == 0x7f)
@@ -107,14 +143,14 @@ static short loop(void)
 				{
 					serial_write(BACKSPACE, sizeof(BACKSPACE));
 				}
-				strcpy(buf, completed);
-				buf_i = strlen(completed);
+				strcpy_P(buf, completed);
+				buf_i = strlen(buf);
 				serial_write(buf, buf_i);
 			}
 			else if (match_count > 1)
 			{
 				serial_write_newline();
-				serial_write(PROMPT, strlen(PROMPT));
+				serial_write_P(PROMPT);
 				serial_write(buf, strlen(buf));
 			}
 		}
@@ -122,10 +158,27 @@ static short loop(void)
 		{
 			serial_write_newline();
 			buf[buf_i++] = 0;
+			hist_pos = 0;
 
-			if (buf_i > 1)
+			if (buf[0] == '!')
 			{
-				strcpy(last_cmd, buf);
+				if (!expand_history(buf))
+				{
+					serial_write_P(HISTORY_NOT_FOUND);
+					serial_write_newline();
+					buf[0] = 0;
+				}
+				else
+				{
+					// Show the command being run, as it was not typed out.
+					serial_write(buf, strlen(buf));
+					serial_write_newline();
+				}
+			}
+
+			if (buf[0] != 0)
+			{
+				history_add(buf);
 			}
 
 			char rc = command_process(buf);
@@ -134,11 +187,10 @@ static short loop(void)
 				return rc;
 			}
 
-			short buf_len = strlen(buf) + 1;
-			memset(buf, 0, buf_len);
+			memset(buf, 0, CMD_BUF_SIZE);
 			buf_i = 0;
 
-			serial_write(PROMPT, strlen(PROMPT));
+			serial_write_P(PROMPT);
 		}
 		else if (c >= 0x20 && c <= 0x7e)
 		{
@@ -158,3 +210,39 @@ static short loop(void)
 
 	return 0;
 }
+
+static void replace_buf(unsigned char* buf, short* buf_i, const unsigned char* s)
+{
+	// First, erase anything currently in the command buffer.
+	for (short i = 0; i < *buf_i; i++)
+	{
+		serial_write(BACKSPACE, sizeof(BACKSPACE));
+	}
+
+	strcpy(buf, s);
+	*buf_i = strlen(buf);
+	serial_write(buf, *buf_i);
+}
+
+// Expands "!!" (previous command) or "!N" (command number N) in place.
+static bool expand_history(unsigned char* buf)
+{
+	if (buf[1] == '!' && buf[2] == 0)
+	{
+		return history_get(0, buf, CMD_BUF_SIZE);
+	}
+
+	unsigned short n = 0;
+	short i = 1;
+	for (; util_is_numeric(buf[i]); i++)
+	{
+		n = n * 10 + (buf[i] - '0');
+	}
+
+	if (i == 1 || buf[i] != 0)
+	{
+		return false;
+	}
+
+	return history_get_number(n, buf, CMD_BUF_SIZE);
+}
@@ -0,0 +1,178 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mandel.h"
+
+#include "fix.h"
+#include "fmt.h"
+#include "serial.h"
+#include "timer.h"
+#include "util.h"
+
+// Draws the Mandelbrot set in ASCII, worked out in 4.12 fixed point (see fix.h
+// for the multiply), and shows how many iterations per second that took. Only
+// the iterations are timed, and "mandel -q" leaves out the drawing altogether.
+//
+// A point stops once it leaves the circle of radius 2, or when it comes back
+// to a value seen before (checked against one saved after 1, 2, 4, 8, ...
+// iterations), since its orbit is then periodic and it is in the set.
+
+#define MANDEL_COLS 80
+#define MANDEL_ROWS 20
+
+#define MANDEL_DEFAULT_ITERS 32
+
+// From -2.0 to 0.5 across, and -1.1 to 1.1 down (in 4.12).
+#define MANDEL_X0 (-2 * FIX12_ONE)
+#define MANDEL_Y0 (-4506)
+#define MANDEL_DX 128
+#define MANDEL_DY 451
+
+#define INSIDE_C '@'
+
+static const char PALETTE[] = " .,:-=+*#%";
+#define PALETTE_LEN (sizeof(PALETTE) - 1)
+
+
+static bool parse_args(const char* str, bool* quiet, unsigned char* max);
+static unsigned char iterate(short cx, short cy, unsigned char max);
+
+
+void mandel_main(const char* str)
+{
+	bool quiet;
+	unsigned char max;
+
+	if (!parse_args(str, &quiet, &max))
+	{
+		serial_write_P(PSTR("bad args"));
+		serial_write_newline();
+
+		return;
+	}
+
+	unsigned long iters = 0;
+	unsigned long cycles = 0;
+
+	for (unsigned char y = 0; y < MANDEL_ROWS; y++)
+	{
+		const short cy = MANDEL_Y0 + (short)y * MANDEL_DY;
+		char row[MANDEL_COLS];
+
+		const unsigned long c0 = timer_get_cycles();
+		for (unsigned char x = 0; x < MANDEL_COLS; x++)
+		{
+			const unsigned char n = iterate(MANDEL_X0 + (short)x * MANDEL_DX, cy, max);
+			iters += n;
+
+			row[x] = (n == max ? INSIDE_C : PALETTE[((unsigned short)n * PALETTE_LEN) / max]);
+		}
+		cycles += timer_get_cycles() - c0;
+
+		if (!quiet)
+		{
+			serial_write(row, MANDEL_COLS);
+			serial_write_newline();
+		}
+	}
+
+	char buf[FMT_U32_MAX_LEN];
+	const unsigned long ms = cycles / (F_CPU / 1000);
+
+	serial_write_P(PSTR("iters "));
+	serial_write(buf, fmt_u32(buf, iters));
+	serial_write_P(PSTR(", per s "));
+	serial_write(buf, fmt_u32(buf, (ms == 0 ? 0 : iters * 1000 / ms)));
+	serial_write_P(PSTR(", cycles/iter "));
+	serial_write(buf, fmt_u32(buf, (iters == 0 ? 0 : cycles / iters)));
+	serial_write_newline();
+}
+
+
+static bool parse_args(const char* str, bool* quiet, unsigned char* max)
+{
+	str += 6; // Skip the "mandel" command at the beginning.
+
+	*quiet = false;
+	*max = MANDEL_DEFAULT_ITERS;
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (str[0] == '-' && str[1] == 'q' && (str[2] == ' ' || str[2] == 0x00))
+	{
+		*quiet = true;
+		str += 2;
+
+		while (*str == ' ')
+		{
+			str++;
+		}
+	}
+
+	if (*str != 0x00)
+	{
+		unsigned short n;
+		if (!util_parse_u16(&str, &n) || n == 0 || n > 255)
+		{
+			return false;
+		}
+		*max = n;
+
+		while (*str == ' ')
+		{
+			str++;
+		}
+	}
+
+	return (*str == 0x00);
+}
+
+// Returns the number of iterations before the point escaped, or max if it didn't.
+static unsigned char iterate(short cx, short cy, unsigned char max)
+{
+	short x = 0;
+	short y = 0;
+
+	short saved_x = 0;
+	short saved_y = 0;
+	unsigned char next_save = 1;
+
+	for (unsigned char n = 0; n < max; n++)
+	{
+		// Within 2 on each axis, the squares stay under 4, so their sum fits in 4.12.
+		if (x >= 2 * FIX12_ONE || x <= -2 * FIX12_ONE || y >= 2 * FIX12_ONE || y <= -2 * FIX12_ONE)
+		{
+			return n;
+		}
+
+		const short x2 = fix12_mul(x, x);
+		const short y2 = fix12_mul(y, y);
+		if ((unsigned short)(x2 + y2) > 4 * FIX12_ONE)
+		{
+			return n;
+		}
+
+		// Inside the circle, |2xy| is at most x^2 + y^2, so this fits too.
+		y = (fix12_mul(x, y) << 1) + cy;
+		x = x2 - y2 + cx;
+
+		if (x == saved_x && y == saved_y)
+		{
+			return max;
+		}
+
+		if (n + 1 == next_save)
+		{
+			saved_x = x;
+			saved_y = y;
+			next_save <<= 1;
+		}
+	}
+
+	return max;
+}
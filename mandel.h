@@ -0,0 +1,6 @@
+#ifndef _MANDEL_H_
+#define _MANDEL_H_
+
+void mandel_main(const char* str);
+
+#endif // _MANDEL_H_
@@ -0,0 +1,329 @@
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "mem.h"
+
+#include "ee.h"
+#include "fmt.h"
+#include "serial.h"
+#include "thread.h"
+#include "util.h"
+
+// "hexdump" reads SRAM, flash (-f, with ELPM above 64 KB on the 2560) or EEPROM
+// (-e, through ee_read() so that writes still queued are seen), 16 bytes to a
+// line, with each line built in full before it is written out. SRAM is only
+// dumped from RAMSTART, since reading some I/O registers (like UDR) has side
+// effects; "peek" and "poke" read and write single bytes anywhere in the data
+// space, I/O registers included.
+
+#define MEM_ROW_BYTES 16
+#define MEM_DEFAULT_LEN 64
+
+#define SPACE_SRAM 0
+#define SPACE_FLASH 1
+#define SPACE_EEPROM 2
+
+#define ABORT_C 0x03
+
+
+static bool parse_number(const char** str, unsigned long* v);
+static void skip_spaces(const char** str);
+static unsigned char read_byte(unsigned char space, unsigned long addr);
+static unsigned char write_addr(char* buf, unsigned long addr, bool wide);
+static void write_row(unsigned char space, unsigned long addr, unsigned char len, bool wide);
+static void write_peek(unsigned short addr);
+static void write_msg(const char* msg);
+
+
+void mem_hexdump(const char* str)
+{
+	str += 7; // Skip the "hexdump" command at the beginning.
+	skip_spaces(&str);
+
+	unsigned char space = SPACE_SRAM;
+	unsigned long start = RAMSTART;
+	unsigned long end = RAMEND;
+
+	if (str[0] == '-' && str[1] == 'f' && str[2] == ' ')
+	{
+		space = SPACE_FLASH;
+		start = 0;
+		end = FLASHEND;
+		str += 3;
+	}
+	else if (str[0] == '-' && str[1] == 'e' && str[2] == ' ')
+	{
+		space = SPACE_EEPROM;
+		start = 0;
+		end = E2END;
+		str += 3;
+	}
+	skip_spaces(&str);
+
+	unsigned long addr;
+	unsigned long len = MEM_DEFAULT_LEN;
+
+	if (!parse_number(&str, &addr))
+	{
+		write_msg(PSTR("bad args"));
+		return;
+	}
+	skip_spaces(&str);
+
+	if (*str != 0x00 && (!parse_number(&str, &len) || len == 0))
+	{
+		write_msg(PSTR("bad args"));
+		return;
+	}
+	skip_spaces(&str);
+
+	if (*str != 0x00)
+	{
+		write_msg(PSTR("bad args"));
+		return;
+	}
+
+	if (addr < start || addr > end)
+	{
+		write_msg(PSTR("bad range"));
+		return;
+	}
+
+	// Stop at the end of the memory rather than refusing.
+	if (len > end - addr + 1)
+	{
+		len = end - addr + 1;
+	}
+
+	const bool wide = (end > 0xffff);
+
+	while (len != 0)
+	{
+		const unsigned char n = (len < MEM_ROW_BYTES ? len : MEM_ROW_BYTES);
+		write_row(space, addr, n, wide);
+		addr += n;
+		len -= n;
+
+		if (thread_is_pipe_closed() || (serial_has_next_byte() && serial_read_next_byte() == ABORT_C))
+		{
+			break;
+		}
+	}
+}
+
+void mem_peek(const char* str)
+{
+	str += 4; // Skip the "peek" command at the beginning.
+	skip_spaces(&str);
+
+	unsigned long addr;
+	if (!parse_number(&str, &addr) || *str != 0x00)
+	{
+		write_msg(PSTR("bad args"));
+		return;
+	}
+
+	if (addr > RAMEND)
+	{
+		write_msg(PSTR("bad range"));
+		return;
+	}
+
+	write_peek(addr);
+}
+
+void mem_poke(const char* str)
+{
+	str += 4; // Skip the "poke" command at the beginning.
+	skip_spaces(&str);
+
+	unsigned long addr;
+	unsigned long v;
+	if (!parse_number(&str, &addr))
+	{
+		write_msg(PSTR("bad args"));
+		return;
+	}
+	skip_spaces(&str);
+
+	if (!parse_number(&str, &v) || *str != 0x00 || v > 0xff)
+	{
+		write_msg(PSTR("bad args"));
+		return;
+	}
+
+	if (addr > RAMEND)
+	{
+		write_msg(PSTR("bad range"));
+		return;
+	}
+
+	*((volatile unsigned char*)(unsigned short)addr) = v;
+
+	// Read it back, as not every bit of a register can be written.
+	write_peek(addr);
+}
+
+
+// Parses a decimal number, or a hex one with "0x" in front.
+static bool parse_number(const char** str, unsigned long* v)
+{
+	const char* s = *str;
+	unsigned char digits = 0;
+
+	*v = 0;
+
+	if (s[0] == '0' && s[1] == 'x')
+	{
+		for (s += 2; ; s++)
+		{
+			const char c = util_to_lower(*s);
+			unsigned char d;
+
+			if (util_is_numeric(c))
+			{
+				d = c - '0';
+			}
+			else if (c >= 'a' && c <= 'f')
+			{
+				d = c - 'a' + 10;
+			}
+			else
+			{
+				break;
+			}
+
+			if ((*v >> 28) != 0)
+			{
+				return false;
+			}
+
+			*v = (*v << 4) | d;
+			digits++;
+		}
+	}
+	else
+	{
+		for ( ; util_is_numeric(*s); s++)
+		{
+			const unsigned char d = (*s - '0');
+
+			if (*v > 429496729 || (*v == 429496729 && d > 5))
+			{
+				return false;
+			}
+
+			*v = (*v * 10) + d;
+			digits++;
+		}
+	}
+
+	if (digits == 0 || (*s != ' ' && *s != 0x00))
+	{
+		return false;
+	}
+
+	*str = s;
+
+	return true;
+}
+
+static void skip_spaces(const char** str)
+{
+	while (**str == ' ')
+	{
+		(*str)++;
+	}
+}
+
+static unsigned char read_byte(unsigned char space, unsigned long addr)
+{
+	switch (space)
+	{
+	case SPACE_FLASH:
+#if (FLASHEND > 0xffff)
+		return pgm_read_byte_far(addr);
+#else
+		return pgm_read_byte((unsigned short)addr);
+#endif
+	case SPACE_EEPROM:
+		return ee_read(addr);
+	default:
+		return *((volatile unsigned char*)(unsigned short)addr);
+	}
+}
+
+static unsigned char write_addr(char* buf, unsigned long addr, bool wide)
+{
+	unsigned char len = 0;
+
+	if (wide)
+	{
+		len += fmt_hex(buf, addr >> 16, 2);
+	}
+	len += fmt_hex(buf + len, addr, 4);
+
+	buf[len++] = ':';
+
+	return len;
+}
+
+static void write_row(unsigned char space, unsigned long addr, unsigned char len, bool wide)
+{
+	// "AAAAAA: " then "xx " for each byte, a space, and the chars.
+	char line[8 + (MEM_ROW_BYTES * 3) + 1 + MEM_ROW_BYTES + 1];
+	unsigned char bytes[MEM_ROW_BYTES];
+
+	for (unsigned char i = 0; i < len; i++)
+	{
+		bytes[i] = read_byte(space, addr + i);
+	}
+
+	unsigned char p = write_addr(line, addr, wide);
+	line[p++] = ' ';
+
+	for (unsigned char i = 0; i < MEM_ROW_BYTES; i++)
+	{
+		if (i < len)
+		{
+			p += fmt_hex(line + p, bytes[i], 2);
+		}
+		else
+		{
+			line[p++] = ' ';
+			line[p++] = ' ';
+		}
+		line[p++] = ' ';
+	}
+	line[p++] = ' ';
+
+	for (unsigned char i = 0; i < len; i++)
+	{
+		const unsigned char c = bytes[i];
+		line[p++] = ((c >= 0x20 && c < 0x7f) ? c : '.');
+	}
+
+	serial_write(line, p);
+	serial_write_newline();
+}
+
+static void write_peek(unsigned short addr)
+{
+	char buf[10];
+
+	unsigned char len = write_addr(buf, addr, false);
+	buf[len++] = ' ';
+	len += fmt_hex(buf + len, *((volatile unsigned char*)addr), 2);
+
+	serial_write(buf, len);
+	serial_write_newline();
+}
+
+static void write_msg(const char* msg)
+{
+	serial_write_P(msg);
+	serial_write_newline();
+}
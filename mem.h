@@ -0,0 +1,8 @@
+#ifndef _MEM_H_
+#define _MEM_H_
+
+void mem_hexdump(const char* str);
+void mem_peek(const char* str);
+void mem_poke(const char* str);
+
+#endif // _MEM_H_
@@ -2,6 +2,8 @@
 
 #include "pm.h"
 
+#include "logger.h"
+#include "lz.h"
 #include "thread.h"
 
 
@@ -27,6 +29,11 @@ void pm_yield()
 	}
 	else
 	{
+		logger_poll();
+
+		// Nothing else to do, so send any compressed output still held back.
+		lz_flush();
+
 		idle_cpu();
 	}
 }
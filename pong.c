@@ -1,3 +1,4 @@
+#include <avr/pgmspace.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,6 +7,8 @@
 #include "game.h"
 
 #include "draw.h"
+#include "fix.h"
+#include "render.h"
 #include "rng.h"
 #include "serial.h"
 #include "term.h"
@@ -20,7 +23,7 @@
 #define SPACE_C ' '
 #define CLEAR_C SPACE_C
 #define RESUME_C SPACE_C
-#define QUIT_C 'Q'
+#define QUIT_C GAME_QUIT_C
 
 #define P0_UP_C 'w'
 #define P0_DOWN_C 's'
@@ -41,6 +44,11 @@
 
 #define PONG_GAME_FPS 24
 
+// Glyphs, which are indices into GLYPHS.
+#define CLEAR_G 0
+#define BALL_G 1
+#define PADDLE_G 2
+
 
 typedef struct
 {
@@ -58,24 +66,33 @@ typedef struct
 } ball_t;
 
 
+static const render_glyph_t GLYPHS[] = {
+	{ CLEAR_C, DRAW_BG_RESET },
+	{ BALL_C, DRAW_BG_RESET },
+	{ PADDLE_C, DRAW_BG_RESET }
+};
+
+
 static void paddle_up(paddle_t* p);
 static void paddle_down(paddle_t* p);
 static void update_ball(ball_t* b);
 static short check_ball_position(ball_t* b, paddle_t* p0, paddle_t* p1);
-static void draw_frame(paddle_t* p0, paddle_t* p1, ball_t* ball, unsigned short* scores);
-static short ball_c2v(short c);
-static short ball_v2c(short v);
+static void draw_frame(render_t* r, paddle_t* p0, paddle_t* p1, ball_t* ball, unsigned short* scores);
 
 
 void pong_main()
 {
+	render_t render;
+	game_context_t ctx;
+	game_context_init(&ctx, PONG_GAME_FPS, &render, &pong_main);
+
 	// Init paddles.
 	paddle_t p0 = { PADDLE_Y_INIT, PADDLE_Y_INIT };
 	paddle_t p1 = { PADDLE_Y_INIT, PADDLE_Y_INIT };
 
 	// Randomize ball starting direction.
-	short ball_vx = 1 << 8;
-	short ball_vy = 1 << 7;
+	short ball_vx = FIX8_ONE;
+	short ball_vy = FIX8_ONE / 2;
 	short r = rng_rand();
 	if (r & 0x0001)
 	{
@@ -87,7 +104,7 @@ void pong_main()
 	}
 
 	// Init ball.
-	ball_t ball = { ball_c2v(BALL_X_INIT_C), ball_c2v(BALL_Y_INIT_C), ball_vx, ball_vy };
+	ball_t ball = { fix8_from_int(BALL_X_INIT_C), fix8_from_int(BALL_Y_INIT_C), ball_vx, ball_vy };
 
 	// Init scores.
 	unsigned short scores[2] = { 0, 0 };
@@ -100,19 +117,21 @@ void pong_main()
 	// Draw walls.
 	draw_border(PONG_WIDTH, PONG_HEIGHT, WALL_C);
 
+	// Everything inside the walls is drawn through the renderer.
+	unsigned char shadow[RENDER_SHADOW_SIZE(PONG_WIDTH - 2, PONG_HEIGHT - 2)];
+	render_init(&render, shadow, 2, 2, PONG_WIDTH - 2, PONG_HEIGHT - 2, GLYPHS);
+
 	// Draw paddles.
-	draw_vertical(PADDLE0_X, p0.y, PADDLE_H, PADDLE_C);
-	draw_vertical(PADDLE1_X, p1.y, PADDLE_H, PADDLE_C);
+	render_put_vertical(&render, PADDLE0_X, p0.y, PADDLE_H, PADDLE_G);
+	render_put_vertical(&render, PADDLE1_X, p1.y, PADDLE_H, PADDLE_G);
 
 	// Draw ball.
-	draw_vertical(ball_v2c(ball.x), ball_v2c(ball.y), 1, BALL_C);
+	render_put(&render, fix8_to_int(ball.x), fix8_to_int(ball.y), BALL_G);
 
+	render_frame(&render);
 	term_cursor_home();
 
 
-	game_context_t ctx;
-	game_context_init(&ctx, PONG_GAME_FPS);
-
 	unsigned char c = game_get_char(&ctx, true);
 	short check = 0;
 	while (1)
@@ -138,7 +157,7 @@ void pong_main()
 			paddle_down(&p1);
 		}
 
-		if (game_should_draw_frame(&ctx))
+		if (game_should_step(&ctx))
 		{
 			update_ball(&ball);
 
@@ -152,7 +171,8 @@ void pong_main()
 				scores[1] += check;
 			}
 
-			draw_frame(&p0, &p1, &ball, check == 0 ? 0 : scores);
+			draw_frame(&render, &p0, &p1, &ball, check == 0 ? 0 : scores);
+			game_draw(&ctx);
 		}
 
 		do {
@@ -162,6 +182,8 @@ void pong_main()
 
 	term_clear_screen();
 	term_set_cursor(true);
+
+	game_context_end(&ctx);
 }
 
 
@@ -187,12 +209,12 @@ static void paddle_down(paddle_t* p)
 
 static void update_ball(ball_t* b)
 {
-	if ((b->vx > 0 && ball_v2c(b->x) >= PONG_WIDTH - 1) || ((b->vx < 0 && ball_v2c(b->x) <= 2)))
+	if ((b->vx > 0 && fix8_to_int(b->x) >= PONG_WIDTH - 1) || ((b->vx < 0 && fix8_to_int(b->x) <= 2)))
 	{
 		b->vx = -b->vx;
 	}
 
-	if ((b->vy > 0 && ball_v2c(b->y) >= PONG_HEIGHT - 1) || ((b->vy < 0 && ball_v2c(b->y) <= 2)))
+	if ((b->vy > 0 && fix8_to_int(b->y) >= PONG_HEIGHT - 1) || ((b->vy < 0 && fix8_to_int(b->y) <= 2)))
 	{
 		b->vy = -b->vy;
 	}
@@ -205,17 +227,17 @@ static short check_ball_position(ball_t* b, paddle_t* p0, paddle_t* p1)
 {
 	short check = 0;
 
-	if (ball_v2c(b->x) == PADDLE0_X)
+	if (fix8_to_int(b->x) == PADDLE0_X)
 	{
-		if (p0->y > ball_v2c(b->y) || p0->y < ball_v2c(b->y) - PADDLE_H)
+		if (p0->y > fix8_to_int(b->y) || p0->y < fix8_to_int(b->y) - PADDLE_H)
 		{
 			// Point for P1.
 			check = 1;
 		}
 	}
-	else if (ball_v2c(b->x) == PADDLE1_X)
+	else if (fix8_to_int(b->x) == PADDLE1_X)
 	{
-		if (p1->y > ball_v2c(b->y) || p1->y < ball_v2c(b->y) - PADDLE_H)
+		if (p1->y > fix8_to_int(b->y) || p1->y < fix8_to_int(b->y) - PADDLE_H)
 		{
 			// Point for P0.
 			check = -1;
@@ -225,29 +247,29 @@ static short check_ball_position(ball_t* b, paddle_t* p0, paddle_t* p1)
 	return check;
 }
 
-static void draw_frame(paddle_t* p0, paddle_t* p1, ball_t* ball, unsigned short* scores)
+static void draw_frame(render_t* r, paddle_t* p0, paddle_t* p1, ball_t* ball, unsigned short* scores)
 {
 	// Redraw paddle 0, if necessary.
 	if (p0->y_prev != p0->y)
 	{
-		draw_vertical(PADDLE0_X, p0->y_prev, PADDLE_H, CLEAR_C);
-		draw_vertical(PADDLE0_X, p0->y, PADDLE_H, PADDLE_C);
+		render_put_vertical(r, PADDLE0_X, p0->y_prev, PADDLE_H, CLEAR_G);
+		render_put_vertical(r, PADDLE0_X, p0->y, PADDLE_H, PADDLE_G);
 		p0->y_prev = p0->y;
 	}
 
 	// Redraw paddle 1, if necessary.
 	if (p1->y_prev != p1->y)
 	{
-		draw_vertical(PADDLE1_X, p1->y_prev, PADDLE_H, CLEAR_C);
-		draw_vertical(PADDLE1_X, p1->y, PADDLE_H, PADDLE_C);
+		render_put_vertical(r, PADDLE1_X, p1->y_prev, PADDLE_H, CLEAR_G);
+		render_put_vertical(r, PADDLE1_X, p1->y, PADDLE_H, PADDLE_G);
 		p1->y_prev = p1->y;
 	}
 
-	short ball_prev_x = ball_v2c(ball->x - ball->vx);
-	short ball_prev_y = ball_v2c(ball->y - ball->vy);
+	short ball_prev_x = fix8_to_int(ball->x - ball->vx);
+	short ball_prev_y = fix8_to_int(ball->y - ball->vy);
 
 	// Determine what is at the ball's previous position.
-	char ball_prev_c;
+	unsigned char ball_prev_g;
 	if (((ball_prev_x == PADDLE0_X) &&
 		(ball_prev_y >= p0->y) &&
 		(ball_prev_y < p0->y + PADDLE_H)) ||
@@ -256,34 +278,24 @@ static void draw_frame(paddle_t* p0, paddle_t* p1, ball_t* ball, unsigned short*
 		(ball_prev_y < p1->y + PADDLE_H)))
 	{
 		// Previous ball position is on paddle.
-		ball_prev_c = PADDLE_C;
+		ball_prev_g = PADDLE_G;
 	}
 	else
 	{
 		// Previous ball position is empty space.
-		ball_prev_c = CLEAR_C;
+		ball_prev_g = CLEAR_G;
 	}
 
 	// Draw new ball position.
-	draw_vertical(ball_prev_x, ball_prev_y, 1, ball_prev_c);
-	draw_vertical(ball_v2c(ball->x), ball_v2c(ball->y), 1, BALL_C);
+	render_put(r, ball_prev_x, ball_prev_y, ball_prev_g);
+	render_put(r, fix8_to_int(ball->x), fix8_to_int(ball->y), BALL_G);
 
 	// Print scores, if necessary.
 	if (scores)
 	{
 		char buf[16];
 		term_move_cursor(SCORE_POS_X, SCORE_POS_Y);
-		sprintf(buf, "%u  -  %u", scores[0], scores[1]);
+		sprintf_P(buf, PSTR("%u  -  %u"), scores[0], scores[1]);
 		serial_write(buf, strlen(buf));
 	}
 }
-
-static short ball_c2v(short c)
-{
-	return (c << 8);
-}
-
-static short ball_v2c(short v)
-{
-	return (v >> 8);
-}
@@ -0,0 +1,271 @@
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rbuf.h"
+
+#include "avr_mcu.h"
+#include "serial.h"
+
+// Named RAM buffers which command output can be redirected into ("cmd > name"),
+// and later replayed from ("cat name", "grep S < name").
+//
+// An unused buffer can also be borrowed as working memory by something which
+// only needs it for a while (such as lz's window), so that it doesn't need
+// RAM of its own the rest of the time.
+
+#define RBUF_NAME_MAX 8
+
+
+typedef struct
+{
+	char name[RBUF_NAME_MAX];
+	const char* owner; // Flash name of whoever borrowed the buffer, or 0.
+	unsigned short len;
+	bool truncated;
+	unsigned char data[RBUF_SIZE];
+} rbuf_t;
+
+static rbuf_t _bufs[RBUF_COUNT];
+
+static rbuf_t* _writing = 0;
+static rbuf_t* _reading = 0;
+static unsigned short _read_pos;
+
+
+static rbuf_t* find_buf(const char* name, unsigned char len);
+static unsigned char name_len(const char* name);
+static void write_byte(unsigned char c);
+static unsigned char read_byte();
+static void write_msg(const char* msg);
+
+
+bool rbuf_start_write(const char* name)
+{
+	const unsigned char len = name_len(name);
+	if (serial_get_tx_hook() != 0 || len == 0 || len >= RBUF_NAME_MAX)
+	{
+		return false;
+	}
+
+	rbuf_t* b = find_buf(name, len);
+	if (b == 0)
+	{
+		// Allocate an unused buffer.
+		b = find_buf("", 0);
+		if (b == 0)
+		{
+			return false;
+		}
+
+		memcpy(b->name, name, len);
+		b->name[len] = 0x00;
+	}
+
+	b->len = 0;
+	b->truncated = false;
+
+	_writing = b;
+	serial_set_tx_hook(&write_byte);
+
+	return true;
+}
+
+// Returns false if the output did not all fit into the buffer.
+bool rbuf_end_write()
+{
+	serial_set_tx_hook(0);
+
+	bool ok = !_writing->truncated;
+	_writing = 0;
+
+	return ok;
+}
+
+bool rbuf_start_read(const char* name)
+{
+	const unsigned char len = name_len(name);
+	if (serial_get_rx_hook() != 0 || len == 0)
+	{
+		return false;
+	}
+
+	rbuf_t* b = find_buf(name, len);
+	if (b == 0)
+	{
+		return false;
+	}
+
+	_reading = b;
+	_read_pos = 0;
+	serial_set_rx_hook(&read_byte);
+
+	return true;
+}
+
+void rbuf_end_read()
+{
+	serial_set_rx_hook(0);
+	_reading = 0;
+}
+
+bool rbuf_exists(const char* name)
+{
+	const unsigned char len = name_len(name);
+	return (len != 0 && find_buf(name, len) != 0);
+}
+
+// Returns false if there is no such buffer, or it is being written or read.
+bool rbuf_delete(const char* name)
+{
+	const unsigned char len = name_len(name);
+	rbuf_t* b = find_buf(name, len);
+	if (b == 0 || len == 0 || b == _writing || b == _reading)
+	{
+		return false;
+	}
+
+	b->name[0] = 0x00;
+	b->len = 0;
+
+	return true;
+}
+
+// Returns RBUF_SIZE bytes of RAM until rbuf_give_back(), or 0 if all
+// buffers are in use.
+unsigned char* rbuf_borrow(const char* owner)
+{
+	rbuf_t* b = find_buf("", 0);
+	if (b == 0)
+	{
+		return 0;
+	}
+
+	b->owner = owner;
+
+	return b->data;
+}
+
+void rbuf_give_back(unsigned char* data)
+{
+	for (unsigned char i = 0; i < RBUF_COUNT; i++)
+	{
+		if (_bufs[i].data == data)
+		{
+			_bufs[i].owner = 0;
+			_bufs[i].len = 0;
+		}
+	}
+}
+
+bool rbuf_cat(const char* name)
+{
+	const unsigned char len = name_len(name);
+	rbuf_t* b = find_buf(name, len);
+	if (b == 0 || len == 0)
+	{
+		return false;
+	}
+
+	serial_write(b->data, b->len);
+
+	return true;
+}
+
+void rbuf_main(const char* str)
+{
+	str += 3; // Skip the "buf" command at the beginning.
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (strncmp_P(str, PSTR("del "), 4) == 0)
+	{
+		if (!rbuf_delete(str + 4))
+		{
+			write_msg(PSTR("not found"));
+		}
+
+		return;
+	}
+
+	char buf[32];
+	for (unsigned char i = 0; i < RBUF_COUNT; i++)
+	{
+		if (_bufs[i].owner != 0)
+		{
+			sprintf_P(buf, PSTR("(%S): in use\r\n"), _bufs[i].owner);
+			serial_write(buf, strlen(buf));
+			continue;
+		}
+
+		if (_bufs[i].name[0] == 0x00)
+		{
+			continue;
+		}
+
+		sprintf_P(buf, PSTR("%s: %u/%u%S\r\n"), _bufs[i].name, _bufs[i].len, RBUF_SIZE, _bufs[i].truncated ? PSTR(" (trunc)") : PSTR(""));
+		serial_write(buf, strlen(buf));
+	}
+}
+
+
+static rbuf_t* find_buf(const char* name, unsigned char len)
+{
+	if (len >= RBUF_NAME_MAX)
+	{
+		return 0;
+	}
+
+	for (unsigned char i = 0; i < RBUF_COUNT; i++)
+	{
+		if (_bufs[i].owner == 0 && strncmp(_bufs[i].name, name, len) == 0 && _bufs[i].name[len] == 0x00)
+		{
+			return &_bufs[i];
+		}
+	}
+
+	return 0;
+}
+
+// Buffer names end at a space or pipe, as with command names.
+static unsigned char name_len(const char* name)
+{
+	unsigned char len = 0;
+	while (name[len] != 0x00 && name[len] != ' ' && name[len] != '|')
+	{
+		len++;
+	}
+
+	return len;
+}
+
+static void write_byte(unsigned char c)
+{
+	if (_writing->len == RBUF_SIZE)
+	{
+		_writing->truncated = true;
+		return;
+	}
+
+	_writing->data[_writing->len++] = c;
+}
+
+static unsigned char read_byte()
+{
+	if (_read_pos == _reading->len)
+	{
+		// End of buffer looks like the end of a pipe.
+		return 0x04;
+	}
+
+	return _reading->data[_read_pos++];
+}
+
+static void write_msg(const char* msg)
+{
+	serial_write_P(msg);
+	serial_write_newline();
+}
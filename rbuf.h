@@ -0,0 +1,19 @@
+#ifndef _RBUF_H_
+#define _RBUF_H_
+
+#include <stdbool.h>
+
+bool rbuf_start_write(const char* name);
+bool rbuf_end_write();
+bool rbuf_start_read(const char* name);
+void rbuf_end_read();
+bool rbuf_exists(const char* name);
+bool rbuf_delete(const char* name);
+
+unsigned char* rbuf_borrow(const char* owner);
+void rbuf_give_back(unsigned char* data);
+
+bool rbuf_cat(const char* name);
+void rbuf_main(const char* str);
+
+#endif // _RBUF_H_
@@ -0,0 +1,375 @@
+#include <string.h>
+
+#include "regex.h"
+
+#include "util.h"
+
+// A small regex engine: ".", "*", "+", "?", "^", "$", "[a-z]" and "[^a-z]"
+// classes, and "\" to match the next char literally.
+//
+// The pattern is compiled into a byte code program, which is run as a Pike VM:
+// every instruction which can be waiting for the next input byte is a state,
+// and all current states are advanced together, once per input byte. Nothing is
+// ever backtracked, and a state is only ever listed once, so each input byte
+// costs at most one pass over the program. A pattern needing more than
+// REGEX_MAX_STATES instructions is refused when compiled.
+//
+// Input is fed one byte at a time, so a line never has to be stored. A new
+// match attempt is started at every position.
+
+#define OP_CHAR 0x01 // CHAR c
+#define OP_ANY 0x02
+#define OP_CLASS 0x03 // CLASS n lo1 hi1 ... lo_n hi_n (n | 0x80 to negate)
+#define OP_SPLIT 0x04 // SPLIT x y
+#define OP_JMP 0x05 // JMP x
+#define OP_BOL 0x06
+#define OP_EOL 0x07
+#define OP_MATCH 0x08
+
+#define CLASS_NEGATE 0x80
+
+
+static bool compile_class(regex_prog_t* re, const char** pattern, unsigned char* p);
+static unsigned char insn_len(const unsigned char* insn);
+static bool insn_accepts(const regex_prog_t* re, const unsigned char* insn, unsigned char c);
+static bool add_state(regex_prog_t* re, unsigned char l, unsigned char pc, bool at_bol, bool at_eol);
+static void push_state(regex_prog_t* re, unsigned char* sp, unsigned char pc);
+
+
+bool regex_compile(regex_prog_t* re, const char* pattern, bool icase)
+{
+	unsigned char* prog = re->prog;
+	unsigned char p = 0;
+	unsigned char insns = 0;
+
+	re->icase = icase;
+
+	if (*pattern == '^')
+	{
+		prog[p++] = OP_BOL;
+		insns++;
+		pattern++;
+	}
+
+	while (*pattern != 0x00)
+	{
+		// Leave room for the largest quantifier, and for the final match.
+		if (p + 2 + 5 + 1 > REGEX_PROG_SIZE)
+		{
+			return false;
+		}
+
+		const unsigned char atom = p;
+
+		if (*pattern == '$' && pattern[1] == 0x00)
+		{
+			prog[p++] = OP_EOL;
+			insns++;
+			pattern++;
+			break;
+		}
+		else if (*pattern == '.')
+		{
+			prog[p++] = OP_ANY;
+			pattern++;
+		}
+		else if (*pattern == '[')
+		{
+			pattern++;
+			if (!compile_class(re, &pattern, &p))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			if (*pattern == '\\' && pattern[1] != 0x00)
+			{
+				pattern++;
+			}
+
+			prog[p++] = OP_CHAR;
+			prog[p++] = (icase ? util_to_lower(*pattern) : *pattern);
+			pattern++;
+		}
+		insns++;
+
+		const unsigned char atom_len = p - atom;
+
+		switch (*pattern)
+		{
+		case '*':
+			// L1: SPLIT L2, L3; L2: atom; JMP L1; L3:
+			memmove(prog + atom + 3, prog + atom, atom_len);
+			prog[atom] = OP_SPLIT;
+			prog[atom + 1] = atom + 3;
+			prog[atom + 2] = atom + 3 + atom_len + 2;
+			p += 3;
+			prog[p++] = OP_JMP;
+			prog[p++] = atom;
+			insns += 2;
+			pattern++;
+			break;
+		case '+':
+			// L1: atom; SPLIT L1, L3; L3:
+			prog[p] = OP_SPLIT;
+			prog[p + 1] = atom;
+			prog[p + 2] = p + 3;
+			p += 3;
+			insns++;
+			pattern++;
+			break;
+		case '?':
+			// SPLIT L2, L3; L2: atom; L3:
+			memmove(prog + atom + 3, prog + atom, atom_len);
+			prog[atom] = OP_SPLIT;
+			prog[atom + 1] = atom + 3;
+			prog[atom + 2] = atom + 3 + atom_len;
+			p += 3;
+			insns++;
+			pattern++;
+			break;
+		}
+
+		if (*pattern == '*' || *pattern == '+' || *pattern == '?')
+		{
+			return false;
+		}
+	}
+
+	if (*pattern != 0x00)
+	{
+		return false;
+	}
+
+	prog[p++] = OP_MATCH;
+	insns++;
+
+	return (insns <= REGEX_MAX_STATES);
+}
+
+// Returns true if the pattern already matches the empty start of the line.
+bool regex_begin_line(regex_prog_t* re)
+{
+	re->cur = 0;
+	re->count[0] = 0;
+	memset(re->mark, 0, sizeof(re->mark));
+
+	return add_state(re, 0, 0, true, false);
+}
+
+// Returns true if the pattern matches the line up to and including c.
+bool regex_step(regex_prog_t* re, unsigned char c)
+{
+	if (re->icase)
+	{
+		c = util_to_lower(c);
+	}
+
+	const unsigned char cur = re->cur;
+	const unsigned char next = cur ^ 1;
+	bool matched = false;
+
+	re->count[next] = 0;
+	memset(re->mark, 0, sizeof(re->mark));
+
+	for (unsigned char i = 0; i < re->count[cur]; i++)
+	{
+		const unsigned char pc = re->list[cur][i];
+		const unsigned char* insn = re->prog + pc;
+
+		if (insn_accepts(re, insn, c))
+		{
+			matched |= add_state(re, next, pc + insn_len(insn), false, false);
+		}
+	}
+
+	// Start another match attempt at the next position.
+	matched |= add_state(re, next, 0, false, false);
+
+	re->cur = next;
+
+	return matched;
+}
+
+// Returns true if the pattern matches at the end of the line (for "$").
+bool regex_end_line(regex_prog_t* re)
+{
+	const unsigned char cur = re->cur;
+	const unsigned char next = cur ^ 1;
+	bool matched = false;
+
+	re->count[next] = 0;
+	memset(re->mark, 0, sizeof(re->mark));
+
+	for (unsigned char i = 0; i < re->count[cur]; i++)
+	{
+		const unsigned char pc = re->list[cur][i];
+		if (re->prog[pc] == OP_EOL)
+		{
+			matched |= add_state(re, next, pc + 1, false, true);
+		}
+	}
+
+	return matched;
+}
+
+
+static bool compile_class(regex_prog_t* re, const char** pattern, unsigned char* p)
+{
+	unsigned char* prog = re->prog;
+	const char* s = *pattern;
+	const unsigned char start = *p;
+
+	prog[start] = OP_CLASS;
+	prog[start + 1] = 0;
+	*p += 2;
+
+	if (*s == '^')
+	{
+		prog[start + 1] = CLASS_NEGATE;
+		s++;
+	}
+
+	// A "]" right at the start is taken literally.
+	bool first = true;
+	while (*s != 0x00 && (*s != ']' || first))
+	{
+		if (*p + 2 + 2 + 5 + 1 > REGEX_PROG_SIZE)
+		{
+			return false;
+		}
+
+		unsigned char lo = *s++;
+		unsigned char hi = lo;
+		if (*s == '-' && s[1] != ']' && s[1] != 0x00)
+		{
+			hi = s[1];
+			s += 2;
+		}
+
+		prog[(*p)++] = lo;
+		prog[(*p)++] = hi;
+		prog[start + 1]++;
+		first = false;
+	}
+
+	if (*s != ']')
+	{
+		return false;
+	}
+
+	*pattern = s + 1;
+
+	return true;
+}
+
+static unsigned char insn_len(const unsigned char* insn)
+{
+	switch (insn[0])
+	{
+	case OP_CHAR:
+	case OP_JMP:
+		return 2;
+	case OP_SPLIT:
+		return 3;
+	case OP_CLASS:
+		return 2 + ((insn[1] & ~CLASS_NEGATE) << 1);
+	default:
+		return 1;
+	}
+}
+
+static bool insn_accepts(const regex_prog_t* re, const unsigned char* insn, unsigned char c)
+{
+	switch (insn[0])
+	{
+	case OP_CHAR:
+		return (insn[1] == c);
+	case OP_ANY:
+		return true;
+	case OP_CLASS:
+	{
+		// With case folding, c is already lower case, so try upper case too.
+		const unsigned char cu = ((re->icase && c >= 'a' && c <= 'z') ? (c - ('a' - 'A')) : c);
+		const unsigned char n = (insn[1] & ~CLASS_NEGATE);
+
+		bool in = false;
+		for (unsigned char i = 0; i < n && !in; i++)
+		{
+			const unsigned char lo = insn[2 + (i << 1)];
+			const unsigned char hi = insn[3 + (i << 1)];
+			in = ((c >= lo && c <= hi) || (cu >= lo && cu <= hi));
+		}
+
+		return (in != ((insn[1] & CLASS_NEGATE) != 0));
+	}
+	default:
+		return false;
+	}
+}
+
+// Adds the states reachable from pc without consuming input to list l, and
+// returns true if that reaches the match.
+static bool add_state(regex_prog_t* re, unsigned char l, unsigned char pc, bool at_bol, bool at_eol)
+{
+	const unsigned char* prog = re->prog;
+	unsigned char sp = 0;
+	bool matched = false;
+
+	push_state(re, &sp, pc);
+
+	while (sp != 0)
+	{
+		pc = re->stack[--sp];
+
+		switch (prog[pc])
+		{
+		case OP_JMP:
+			push_state(re, &sp, prog[pc + 1]);
+			break;
+		case OP_SPLIT:
+			push_state(re, &sp, prog[pc + 2]);
+			push_state(re, &sp, prog[pc + 1]);
+			break;
+		case OP_BOL:
+			if (at_bol)
+			{
+				push_state(re, &sp, pc + 1);
+			}
+			break;
+		case OP_EOL:
+			if (at_eol)
+			{
+				push_state(re, &sp, pc + 1);
+			}
+			else
+			{
+				re->list[l][re->count[l]++] = pc;
+			}
+			break;
+		case OP_MATCH:
+			matched = true;
+			break;
+		default:
+			re->list[l][re->count[l]++] = pc;
+			break;
+		}
+	}
+
+	return matched;
+}
+
+// Each instruction is visited at most once per input byte, which is what bounds
+// both the stack and the state lists by the number of instructions.
+static void push_state(regex_prog_t* re, unsigned char* sp, unsigned char pc)
+{
+	unsigned char* m = &re->mark[pc >> 3];
+	const unsigned char bit = (1 << (pc & 0x07));
+
+	if ((*m & bit) == 0)
+	{
+		*m |= bit;
+		re->stack[(*sp)++] = pc;
+	}
+}
@@ -0,0 +1,24 @@
+#ifndef _REGEX_H_
+#define _REGEX_H_
+
+#include <stdbool.h>
+
+#include "avr_mcu.h"
+
+typedef struct
+{
+	unsigned char prog[REGEX_PROG_SIZE];
+	unsigned char list[2][REGEX_MAX_STATES];
+	unsigned char count[2];
+	unsigned char cur;
+	unsigned char stack[REGEX_MAX_STATES];
+	unsigned char mark[(REGEX_PROG_SIZE + 7) >> 3];
+	bool icase;
+} regex_prog_t;
+
+bool regex_compile(regex_prog_t* re, const char* pattern, bool icase);
+bool regex_begin_line(regex_prog_t* re);
+bool regex_step(regex_prog_t* re, unsigned char c);
+bool regex_end_line(regex_prog_t* re);
+
+#endif // _REGEX_H_
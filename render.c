@@ -0,0 +1,203 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "render.h"
+
+#include "term.h"
+
+// The games draw their boards through a render_t instead of straight to the
+// terminal. Each render_put() only records the cell, so a cell which is drawn
+// more than once in a frame (like a paddle which is cleared and then redrawn
+// one row over) costs nothing extra, and render_frame() sends only the cells
+// which differ from what is already on screen, in screen order so that most
+// cursor moves are short (see term_move_cursor()).
+//
+// What is on screen is kept in the shadow buffer, which the caller provides
+// and which holds RENDER_CELL_BITS per cell: the glyph index, if it is below
+// RENDER_OTHER. Any glyph from RENDER_OTHER up is stored as RENDER_OTHER, which
+// is never taken as a match, so games should put their most often drawn glyphs
+// first in the table. Glyph 0 is blank, which the region must be on screen
+// when render_init() is called.
+
+#define RENDER_OTHER ((1 << RENDER_CELL_BITS) - 1)
+
+
+static void flush(render_t* r);
+static void move_to(render_t* r, unsigned char x, unsigned char y);
+static bool can_rewrite(const render_t* r, unsigned char x0, unsigned char x1, unsigned char y);
+static unsigned char get_shadow(const render_t* r, unsigned char x, unsigned char y);
+static void set_shadow(render_t* r, unsigned char x, unsigned char y, unsigned char v);
+static void emit(render_t* r, char c);
+
+
+void render_init(render_t* r, unsigned char* shadow, short x, short y, short w, short h, const render_glyph_t* glyphs)
+{
+	memset(shadow, 0, RENDER_SHADOW_SIZE(w, h));
+
+	r->glyphs = glyphs;
+	r->shadow = shadow;
+	r->x0 = x;
+	r->y0 = y;
+	r->w = w;
+	r->h = h;
+	r->pending_count = 0;
+	r->frame_bytes = 0;
+	r->last_frame_bytes = 0;
+	r->max_frame_bytes = 0;
+	r->total_bytes = 0;
+	r->frames = 0;
+}
+
+// Cells outside of the region are ignored.
+void render_put(render_t* r, short x, short y, unsigned char glyph)
+{
+	x -= r->x0;
+	y -= r->y0;
+
+	if (x < 0 || y < 0 || x >= r->w || y >= r->h)
+	{
+		return;
+	}
+
+	const unsigned short key = (y << 8) | x;
+
+	unsigned char i = r->pending_count;
+	while (i > 0 && ((r->pending[i - 1].y << 8) | r->pending[i - 1].x) > key)
+	{
+		i--;
+	}
+
+	if (i > 0 && r->pending[i - 1].x == x && r->pending[i - 1].y == y)
+	{
+		r->pending[i - 1].glyph = glyph;
+		return;
+	}
+
+	if (r->pending_count == RENDER_PENDING_SIZE)
+	{
+		// Too much for one go, so send what is there already.
+		flush(r);
+		i = 0;
+	}
+
+	memmove(r->pending + i + 1, r->pending + i, (r->pending_count - i) * sizeof(render_cell_t));
+	r->pending[i].x = x;
+	r->pending[i].y = y;
+	r->pending[i].glyph = glyph;
+	r->pending_count++;
+}
+
+void render_put_horizontal(render_t* r, short x, short y, short l, unsigned char glyph)
+{
+	for (short i = 0; i < l; i++)
+	{
+		render_put(r, x + i, y, glyph);
+	}
+}
+
+void render_put_vertical(render_t* r, short x, short y, short h, unsigned char glyph)
+{
+	for (short i = 0; i < h; i++)
+	{
+		render_put(r, x, y + i, glyph);
+	}
+}
+
+void render_frame(render_t* r)
+{
+	flush(r);
+	r->frame_bytes += draw_set_bg(DRAW_BG_RESET);
+
+	r->last_frame_bytes = r->frame_bytes;
+	if (r->frame_bytes > r->max_frame_bytes)
+	{
+		r->max_frame_bytes = r->frame_bytes;
+	}
+	r->total_bytes += r->frame_bytes;
+	r->frames++;
+	r->frame_bytes = 0;
+}
+
+
+static void flush(render_t* r)
+{
+	for (unsigned char i = 0; i < r->pending_count; i++)
+	{
+		const render_cell_t* cell = &r->pending[i];
+		const unsigned char v = (cell->glyph < RENDER_OTHER ? cell->glyph : RENDER_OTHER);
+
+		if (v != RENDER_OTHER && get_shadow(r, cell->x, cell->y) == v)
+		{
+			continue;
+		}
+
+		const render_glyph_t* g = &r->glyphs[cell->glyph];
+
+		move_to(r, cell->x, cell->y);
+		r->frame_bytes += draw_set_bg(g->bg);
+		emit(r, g->c);
+
+		set_shadow(r, cell->x, cell->y, v);
+	}
+
+	r->pending_count = 0;
+}
+
+static void move_to(render_t* r, unsigned char x, unsigned char y)
+{
+	const short tx = r->x0 + x;
+	const short ty = r->y0 + y;
+	short cx;
+	short cy;
+
+	if (term_get_cursor(&cx, &cy) && cy == ty && cx >= r->x0 && cx < tx)
+	{
+		const unsigned char from = cx - r->x0;
+
+		if (x - from < term_move_cost(tx, ty) && can_rewrite(r, from, x, y))
+		{
+			// Cheaper to just write out what is already there.
+			for (unsigned char i = from; i < x; i++)
+			{
+				emit(r, r->glyphs[get_shadow(r, i, y)].c);
+			}
+			return;
+		}
+	}
+
+	r->frame_bytes += term_move_cursor(tx, ty);
+}
+
+// Whether the cells from x0 up to x1 are all known and in the current background.
+static bool can_rewrite(const render_t* r, unsigned char x0, unsigned char x1, unsigned char y)
+{
+	for (unsigned char i = x0; i < x1; i++)
+	{
+		const unsigned char v = get_shadow(r, i, y);
+		if (v == RENDER_OTHER || !draw_bg_is(r->glyphs[v].bg))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static unsigned char get_shadow(const render_t* r, unsigned char x, unsigned char y)
+{
+	const unsigned short bit = ((unsigned short)y * r->w + x) * RENDER_CELL_BITS;
+	return ((r->shadow[bit >> 3] >> (bit & 0x07)) & RENDER_OTHER);
+}
+
+static void set_shadow(render_t* r, unsigned char x, unsigned char y, unsigned char v)
+{
+	const unsigned short bit = ((unsigned short)y * r->w + x) * RENDER_CELL_BITS;
+	unsigned char* p = &r->shadow[bit >> 3];
+	*p = (*p & ~(RENDER_OTHER << (bit & 0x07))) | (v << (bit & 0x07));
+}
+
+static void emit(render_t* r, char c)
+{
+	term_write(&c, 1);
+	r->frame_bytes++;
+}
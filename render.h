@@ -0,0 +1,52 @@
+#ifndef _RENDER_H_
+#define _RENDER_H_
+
+#include "avr_mcu.h"
+#include "draw.h"
+
+#define RENDER_SHADOW_SIZE(w, h) (((unsigned short)(w) * (h) * RENDER_CELL_BITS + 7) >> 3)
+
+
+typedef struct
+{
+	char c;
+	draw_bg_setting bg;
+} render_glyph_t;
+
+typedef struct
+{
+	unsigned char x;
+	unsigned char y;
+	unsigned char glyph;
+} render_cell_t;
+
+typedef struct
+{
+	const render_glyph_t* glyphs;
+	unsigned char* shadow;
+
+	// Screen position and size of the region drawn through the renderer.
+	short x0;
+	short y0;
+	unsigned char w;
+	unsigned char h;
+
+	// Cells changed since the last frame, sorted by row and then column.
+	render_cell_t pending[RENDER_PENDING_SIZE];
+	unsigned char pending_count;
+
+	unsigned short frame_bytes;
+	unsigned short last_frame_bytes;
+	unsigned short max_frame_bytes;
+	unsigned long total_bytes;
+	unsigned long frames;
+} render_t;
+
+
+void render_init(render_t* r, unsigned char* shadow, short x, short y, short w, short h, const render_glyph_t* glyphs);
+void render_put(render_t* r, short x, short y, unsigned char glyph);
+void render_put_horizontal(render_t* r, short x, short y, short l, unsigned char glyph);
+void render_put_vertical(render_t* r, short x, short y, short h, unsigned char glyph);
+void render_frame(render_t* r);
+
+#endif // _RENDER_H_
@@ -1,3 +1,5 @@
+#include <stdbool.h>
+
 #include "rng.h"
 
 // A simple 16-bit LCG implementation that allows for adding optional entropy.
@@ -7,13 +9,35 @@
 #define C 17863
 
 static volatile unsigned short _r = 8161;
+static volatile bool _entropy = true;
 
 void rng_add_entropy(unsigned char e)
 {
+	if (!_entropy)
+	{
+		return;
+	}
+
 	_r <<= 1;
 	_r |= (e & 0x0001);
 }
 
+// While off, the sequence depends only on the seed (so it can be replayed).
+void rng_set_entropy(bool on)
+{
+	_entropy = on;
+}
+
+unsigned short rng_get_seed()
+{
+	return _r;
+}
+
+void rng_set_seed(unsigned short seed)
+{
+	_r = seed;
+}
+
 short rng_rand()
 {
 	_r = A * _r + C;
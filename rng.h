@@ -1,7 +1,12 @@
 #ifndef _RNG_H_
 #define _RNG_H_
 
+#include <stdbool.h>
+
 void rng_add_entropy(unsigned char e);
+void rng_set_entropy(bool on);
+unsigned short rng_get_seed();
+void rng_set_seed(unsigned short seed);
 short rng_rand();
 
 #endif // _RNG_H_
@@ -0,0 +1,581 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "script.h"
+
+#include "avr_mcu.h"
+#include "command.h"
+#include "ee.h"
+#include "serial.h"
+
+// Scripts and aliases are kept in EEPROM as a list of length-prefixed records:
+//   [len][type][name...][0x00][body...]
+// where "len" counts the bytes following it, and script bodies hold one
+// command per line, separated by '\n'. The list ends at the first 0xff length
+// byte (erased EEPROM) or at the end of the region.
+
+#define SCRIPT_TYPE_SCRIPT 's'
+#define SCRIPT_TYPE_ALIAS 'a'
+
+#define SCRIPT_END 0xff
+#define SCRIPT_NAME_MAX 12
+#define SCRIPT_INPUT_MAX 32
+
+#define SCRIPT_ABORT_C 0x03
+
+static const char* SCRIPT_AUTORUN = "autorun";
+static const char SCRIPT_INPUT_PROMPT[] PROGMEM = "+ ";
+static const unsigned char BACKSPACE[6] = { 0x1b, '[', 'D', 0x1b, '[', 'K' };
+
+static bool _running = false;
+
+
+static void script_save(const char* name, unsigned short name_len);
+static void script_list();
+static void script_show(short off);
+static bool script_del(const char* name, unsigned short name_len);
+static void delete_record(unsigned short off);
+static char script_run(short off);
+static short find_record(const char* name, unsigned short name_len, unsigned char type);
+static unsigned short find_end();
+static bool write_record_start(unsigned short end, unsigned char type, const char* name, unsigned short name_len, unsigned short* pos);
+static void commit_record(unsigned short end, unsigned short pos);
+static unsigned short read_line(char* buf, unsigned short size);
+static const char* next_word(const char* str, unsigned short* len);
+static bool is_valid_name(const char* name, unsigned short len);
+static unsigned char rec_read(unsigned short off);
+static void rec_write(unsigned short off, unsigned char c);
+static void write_msg(const char* msg);
+
+
+char script_main(const char* str)
+{
+	unsigned short sub_len;
+	unsigned short name_len;
+
+	const char* sub = next_word(str + 6, &sub_len); // Skip "script".
+	const char* name = next_word(sub + sub_len, &name_len);
+
+	if (sub_len == 4 && strncmp_P(sub, PSTR("list"), 4) == 0)
+	{
+		script_list();
+		return 0;
+	}
+
+	if (!is_valid_name(name, name_len))
+	{
+		write_msg(PSTR("bad args"));
+		return 0;
+	}
+
+	short off = find_record(name, name_len, SCRIPT_TYPE_SCRIPT);
+
+	if (sub_len == 4 && strncmp_P(sub, PSTR("save"), 4) == 0)
+	{
+		script_save(name, name_len);
+	}
+	else if (sub_len == 3 && strncmp_P(sub, PSTR("del"), 3) == 0)
+	{
+		if (!script_del(name, name_len))
+		{
+			write_msg(PSTR("not found"));
+		}
+	}
+	else if (sub_len == 3 && strncmp_P(sub, PSTR("run"), 3) == 0)
+	{
+		if (off < 0)
+		{
+			write_msg(PSTR("not found"));
+		}
+		else
+		{
+			return script_run(off);
+		}
+	}
+	else if (sub_len == 4 && strncmp_P(sub, PSTR("show"), 4) == 0)
+	{
+		if (off < 0)
+		{
+			write_msg(PSTR("not found"));
+		}
+		else
+		{
+			script_show(off);
+		}
+	}
+	else
+	{
+		write_msg(PSTR("bad args"));
+	}
+
+	return 0;
+}
+
+void script_alias_main(const char* str)
+{
+	unsigned short name_len;
+	unsigned short body_len;
+
+	const char* name = next_word(str + 5, &name_len); // Skip "alias".
+	const char* body = next_word(name + name_len, &body_len);
+
+	if (name_len == 0)
+	{
+		script_list();
+		return;
+	}
+
+	// "alias -d N" deletes an alias.
+	if (name_len == 2 && strncmp_P(name, PSTR("-d"), 2) == 0)
+	{
+		const short off = find_record(body, body_len, SCRIPT_TYPE_ALIAS);
+		if (!is_valid_name(body, body_len) || off < 0)
+		{
+			write_msg(PSTR("not found"));
+		}
+		else
+		{
+			delete_record(off);
+		}
+
+		return;
+	}
+
+	body_len = strlen(body);
+	if (!is_valid_name(name, name_len) || body_len == 0)
+	{
+		write_msg(PSTR("bad args"));
+		return;
+	}
+
+	// The old alias is only removed once the new one is in, so that it is kept if there is no space.
+	const short old = find_record(name, name_len, SCRIPT_TYPE_ALIAS);
+
+	const unsigned short end = find_end();
+	unsigned short pos;
+	if (!write_record_start(end, SCRIPT_TYPE_ALIAS, name, name_len, &pos) ||
+		pos + body_len > SCRIPT_EEPROM_SIZE)
+	{
+		write_msg(PSTR("no space"));
+		return;
+	}
+
+	for (unsigned short i = 0; i < body_len; i++)
+	{
+		rec_write(pos++, body[i]);
+	}
+
+	commit_record(end, pos);
+
+	if (old >= 0)
+	{
+		delete_record(old);
+	}
+}
+
+char script_autorun()
+{
+	short off = find_record(SCRIPT_AUTORUN, strlen(SCRIPT_AUTORUN), SCRIPT_TYPE_SCRIPT);
+	if (off < 0)
+	{
+		return 0;
+	}
+
+	return script_run(off);
+}
+
+bool script_expand_alias(const char* cmd, char* out, unsigned short out_size)
+{
+	unsigned short name_len = 0;
+	while (cmd[name_len] != 0x00 && cmd[name_len] != ' ' && cmd[name_len] != '|')
+	{
+		name_len++;
+	}
+
+	short off = find_record(cmd, name_len, SCRIPT_TYPE_ALIAS);
+	if (off < 0)
+	{
+		return false;
+	}
+
+	const unsigned short rec_end = off + 1 + rec_read(off);
+	unsigned short pos = off + 2 + name_len + 1;
+	unsigned short i = 0;
+
+	while (pos < rec_end && i < out_size - 1)
+	{
+		out[i++] = rec_read(pos++);
+	}
+
+	// Append any arguments given after the alias name.
+	const char* rest = cmd + name_len;
+	while (*rest != 0x00 && i < out_size - 1)
+	{
+		out[i++] = *(rest++);
+	}
+	out[i] = 0x00;
+
+	return (*rest == 0x00);
+}
+
+
+static void script_save(const char* name, unsigned short name_len)
+{
+	char line[SCRIPT_INPUT_MAX];
+
+	// As for aliases, the old script is kept until the new one has been saved.
+	const short old = find_record(name, name_len, SCRIPT_TYPE_SCRIPT);
+
+	const unsigned short end = find_end();
+	unsigned short pos;
+	if (!write_record_start(end, SCRIPT_TYPE_SCRIPT, name, name_len, &pos))
+	{
+		write_msg(PSTR("no space"));
+		return;
+	}
+
+	write_msg(PSTR("enter commands, empty line to end:"));
+
+	const unsigned short body_start = pos;
+	while (true)
+	{
+		unsigned short len = read_line(line, sizeof(line));
+		if (len == 0)
+		{
+			break;
+		}
+
+		// Separate from the previous line, and keep room for the record length limit.
+		const unsigned short need = len + (pos == body_start ? 0 : 1);
+		if (pos + need > SCRIPT_EEPROM_SIZE || pos + need - end - 1 > 0xfe)
+		{
+			write_msg(PSTR("no space"));
+			return;
+		}
+
+		if (pos != body_start)
+		{
+			rec_write(pos++, '\n');
+		}
+
+		for (unsigned short i = 0; i < len; i++)
+		{
+			rec_write(pos++, line[i]);
+		}
+	}
+
+	commit_record(end, pos);
+
+	if (old >= 0)
+	{
+		delete_record(old);
+	}
+}
+
+static void script_list()
+{
+	char buf[48];
+	unsigned short off = 0;
+
+	while (off < SCRIPT_EEPROM_SIZE)
+	{
+		const unsigned char len = rec_read(off);
+		if (len == SCRIPT_END || len == 0)
+		{
+			break;
+		}
+
+		const unsigned char type = rec_read(off + 1);
+
+		unsigned short i = 0;
+		unsigned short pos = off + 2;
+		char c;
+		while ((c = rec_read(pos++)) != 0x00 && i < SCRIPT_NAME_MAX)
+		{
+			buf[i++] = c;
+		}
+		buf[i] = 0x00;
+
+		serial_write(buf, i);
+		if (type == SCRIPT_TYPE_ALIAS)
+		{
+			serial_write_P(PSTR(" = "));
+			while (pos < off + 1 + len)
+			{
+				serial_tx_byte(rec_read(pos++));
+			}
+			serial_write_newline();
+		}
+		else
+		{
+			sprintf_P(buf, PSTR(": script, %u bytes\r\n"), off + 1 + len - pos);
+			serial_write(buf, strlen(buf));
+		}
+
+		off += 1 + len;
+	}
+
+	sprintf_P(buf, PSTR("free: %u bytes\r\n"), SCRIPT_EEPROM_SIZE - off);
+	serial_write(buf, strlen(buf));
+}
+
+static void script_show(short off)
+{
+	const unsigned short rec_end = off + 1 + rec_read(off);
+	unsigned short pos = off + 2;
+
+	while (rec_read(pos++) != 0x00) { }
+
+	while (pos < rec_end)
+	{
+		const unsigned char c = rec_read(pos++);
+		if (c == '\n')
+		{
+			serial_write_newline();
+		}
+		else
+		{
+			serial_tx_byte(c);
+		}
+	}
+	serial_write_newline();
+}
+
+static bool script_del(const char* name, unsigned short name_len)
+{
+	short off = find_record(name, name_len, SCRIPT_TYPE_SCRIPT);
+	if (off < 0)
+	{
+		return false;
+	}
+
+	delete_record(off);
+
+	return true;
+}
+
+static void delete_record(unsigned short off)
+{
+	const unsigned short end = find_end();
+	unsigned short from = off + 1 + rec_read(off);
+	unsigned short to = off;
+
+	// Shift all following records down over the deleted one.
+	while (from < end)
+	{
+		rec_write(to++, rec_read(from++));
+	}
+	rec_write(to, SCRIPT_END);
+}
+
+static char script_run(short off)
+{
+	if (_running)
+	{
+		write_msg(PSTR("nested script"));
+		return 0;
+	}
+
+	char line[SCRIPT_LINE_MAX];
+	const unsigned short rec_end = off + 1 + rec_read(off);
+	unsigned short pos = off + 2;
+	char rc = 0;
+
+	while (rec_read(pos++) != 0x00) { }
+
+	_running = true;
+	while (pos < rec_end && rc >= 0)
+	{
+		unsigned short i = 0;
+		unsigned char c;
+		while (pos < rec_end && (c = rec_read(pos++)) != '\n')
+		{
+			if (i < sizeof(line) - 1)
+			{
+				line[i++] = c;
+			}
+		}
+		line[i] = 0x00;
+
+		rc = command_process(line);
+
+		// Allow a runaway script (e.g. an autorun that resets) to be interrupted.
+		if (serial_has_next_byte() && serial_read_next_byte() == SCRIPT_ABORT_C)
+		{
+			write_msg(PSTR("script stopped"));
+			break;
+		}
+	}
+	_running = false;
+
+	return rc;
+}
+
+// Finds a record by name and type, as a script and an alias may share a name.
+static short find_record(const char* name, unsigned short name_len, unsigned char type)
+{
+	unsigned short off = 0;
+
+	while (off < SCRIPT_EEPROM_SIZE)
+	{
+		const unsigned char len = rec_read(off);
+		if (len == SCRIPT_END || len == 0 || off + 1 + len > SCRIPT_EEPROM_SIZE)
+		{
+			break;
+		}
+
+		if (rec_read(off + 1) == type)
+		{
+			unsigned short i = 0;
+			while (i < name_len && rec_read(off + 2 + i) == name[i])
+			{
+				i++;
+			}
+
+			if (i == name_len && rec_read(off + 2 + i) == 0x00)
+			{
+				return off;
+			}
+		}
+
+		off += 1 + len;
+	}
+
+	return -1;
+}
+
+static unsigned short find_end()
+{
+	unsigned short off = 0;
+
+	while (off < SCRIPT_EEPROM_SIZE)
+	{
+		const unsigned char len = rec_read(off);
+		if (len == SCRIPT_END || len == 0 || off + 1 + len > SCRIPT_EEPROM_SIZE)
+		{
+			break;
+		}
+
+		off += 1 + len;
+	}
+
+	return off;
+}
+
+// Writes the type and name of a new record after the current end of the list,
+// leaving its length byte (still the end marker) to be written by commit_record().
+static bool write_record_start(unsigned short end, unsigned char type, const char* name, unsigned short name_len, unsigned short* pos)
+{
+	if (end + 2 + name_len + 1 > SCRIPT_EEPROM_SIZE)
+	{
+		return false;
+	}
+
+	*pos = end + 1;
+	rec_write((*pos)++, type);
+	for (unsigned short i = 0; i < name_len; i++)
+	{
+		rec_write((*pos)++, name[i]);
+	}
+	rec_write((*pos)++, 0x00);
+
+	return true;
+}
+
+// The new end marker is written before the length byte, so that an interrupted
+// save leaves the previous list intact.
+static void commit_record(unsigned short end, unsigned short pos)
+{
+	if (pos < SCRIPT_EEPROM_SIZE)
+	{
+		rec_write(pos, SCRIPT_END);
+	}
+	rec_write(end, pos - end - 1);
+}
+
+static unsigned short read_line(char* buf, unsigned short size)
+{
+	unsigned short i = 0;
+
+	serial_write_P(SCRIPT_INPUT_PROMPT);
+
+	while (true)
+	{
+		unsigned char c = serial_read_next_byte();
+
+		if (c == 0x0d)
+		{
+			serial_write_newline();
+			break;
+		}
+		else if (c == 0x08 || c == 0x7f)
+		{
+			if (i != 0)
+			{
+				serial_write(BACKSPACE, sizeof(BACKSPACE));
+				i--;
+			}
+		}
+		else if (c >= 0x20 && c <= 0x7e && i < size - 1)
+		{
+			serial_tx_byte(c);
+			buf[i++] = c;
+		}
+	}
+
+	buf[i] = 0x00;
+	return i;
+}
+
+static const char* next_word(const char* str, unsigned short* len)
+{
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	*len = 0;
+	while (str[*len] != 0x00 && str[*len] != ' ')
+	{
+		(*len)++;
+	}
+
+	return str;
+}
+
+static bool is_valid_name(const char* name, unsigned short len)
+{
+	if (len == 0 || len > SCRIPT_NAME_MAX)
+	{
+		return false;
+	}
+
+	for (unsigned short i = 0; i < len; i++)
+	{
+		const char c = name[i];
+		if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_'))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static unsigned char rec_read(unsigned short off)
+{
+	return ee_read(SCRIPT_EEPROM_ADDR + off);
+}
+
+static void rec_write(unsigned short off, unsigned char c)
+{
+	ee_write(SCRIPT_EEPROM_ADDR + off, c);
+}
+
+static void write_msg(const char* msg)
+{
+	serial_write_P(msg);
+	serial_write_newline();
+}
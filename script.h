@@ -0,0 +1,13 @@
+#ifndef _SCRIPT_H_
+#define _SCRIPT_H_
+
+#include <stdbool.h>
+
+#define SCRIPT_LINE_MAX 64
+
+char script_main(const char* str);
+void script_alias_main(const char* str);
+char script_autorun();
+bool script_expand_alias(const char* cmd, char* out, unsigned short out_size);
+
+#endif // _SCRIPT_H_
@@ -1,91 +1,256 @@
+#include <avr/pgmspace.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "seq.h"
+
+#include "fmt.h"
 #include "serial.h"
+#include "thread.h"
 #include "util.h"
 
-static bool parse_args(const char* str, unsigned short* a, unsigned short* b);
+// The current number is kept as a string of decimal digits, and the step is
+// added to it digit by digit, so each number costs about as many digit
+// additions as the step has digits rather than a full conversion. The binary
+// value is only kept alongside to know when to stop.
+
+#define SEQ_DIGITS 10
+#define SEQ_SEP_MAX 8
+
+#define ABORT_C 0x03
+
+
+typedef struct
+{
+	unsigned long first;
+	unsigned long step;
+	unsigned long last;
+	bool pad;
+	char sep[SEQ_SEP_MAX + 1];
+} seq_args_t;
+
+
+static bool parse_args(const char* str, seq_args_t* args);
+static bool parse_number(const char** str, unsigned long* v);
+static unsigned char first_digit(const char* digits);
+static void write_sep(const seq_args_t* args);
+
 
 void seq_main(const char* str)
 {
-	unsigned short a;
-	unsigned short b;
+	seq_args_t args;
 
-	if (!parse_args(str, &a, &b))
+	if (!parse_args(str, &args))
 	{
-		char buf[9];
-		sprintf(buf, "bad args");
-		serial_write(buf, strlen(buf));
+		serial_write_P(PSTR("bad args"));
 		serial_write_newline();
 
 		return;
 	}
 
-	unsigned short i;
-	char buf[8];
-	for (i = a; i <= b; i++)
+	if (args.first > args.last)
 	{
-		sprintf(buf, "%u", i);
-		serial_write(buf, strlen(buf));
-		serial_write_newline();
+		return;
+	}
+
+	char num[SEQ_DIGITS + 1];
+	char step[SEQ_DIGITS + 1];
+	fmt_u32_pad(num, args.first, SEQ_DIGITS, '0');
+	fmt_u32_pad(step, args.step, SEQ_DIGITS, '0');
+
+	// Index of the first digit written out.
+	unsigned char start = first_digit(num);
+	if (args.pad)
+	{
+		char last[SEQ_DIGITS + 1];
+		fmt_u32_pad(last, args.last, SEQ_DIGITS, '0');
+		start = first_digit(last);
+	}
+
+	const unsigned char step_start = first_digit(step);
+
+	unsigned long i = args.first;
+	while (true)
+	{
+		serial_write(num + start, SEQ_DIGITS - start);
+
+		// Stop before going past the last number (or overflowing).
+		if (args.last - i < args.step)
+		{
+			break;
+		}
+		i += args.step;
+
+		write_sep(&args);
+
+		signed char k = SEQ_DIGITS - 1;
+		char carry = 0;
+		while (k >= step_start || carry != 0)
+		{
+			char d = num[k] + (step[k] - '0') + carry;
+			carry = (d > '9');
+			if (carry != 0)
+			{
+				d -= 10;
+			}
+			num[k--] = d;
+		}
+
+		// The highest digit written is never zero, since i still fits.
+		if (k + 1 < start)
+		{
+			start = k + 1;
+		}
+
+		// Stop early once nothing reads the rest (e.g. "seq 1 100000 | head").
+		if (thread_is_pipe_closed() || (serial_has_next_byte() && serial_read_next_byte() == ABORT_C))
+		{
+			break;
+		}
 	}
+
+	serial_write_newline();
 }
 
-static bool parse_args(const char* str, unsigned short* a, unsigned short* b)
+static bool parse_args(const char* str, seq_args_t* args)
 {
-	char c;
+	str += 3; // Skip the "seq" command at the beginning.
 
-	*a = 0;
-	*b = 0;
+	unsigned long n[3];
+	unsigned char count = 0;
 
-	// Keep going until we get a numeric char.
-	while (!util_is_numeric(c = *str))
+	args->pad = false;
+	args->sep[0] = 0x00;
+
+	while (*str != 0x00)
 	{
-		if (c == 0x00)
+		// Next char must be a space.
+		if (*str != ' ')
 		{
 			return false;
 		}
 
-		str++;
+		// Skip all remaining spaces.
+		while (*str == ' ')
+		{
+			str++;
+		}
+
+		if (*str == 0x00)
+		{
+			break;
+		}
+
+		if (count == 0 && str[0] == '-' && str[1] == 'w')
+		{
+			args->pad = true;
+			str += 2;
+		}
+		else if (count == 0 && str[0] == '-' && str[1] == 's' && str[2] == ' ')
+		{
+			str += 3;
+			while (*str == ' ')
+			{
+				str++;
+			}
+
+			unsigned char len = 0;
+			while (*str != ' ' && *str != 0x00)
+			{
+				if (len == SEQ_SEP_MAX)
+				{
+					return false;
+				}
+				args->sep[len++] = *str++;
+			}
+			args->sep[len] = 0x00;
+
+			if (len == 0)
+			{
+				return false;
+			}
+		}
+		else if (count == 3 || !parse_number(&str, &n[count++]))
+		{
+			return false;
+		}
 	}
 
-	// Parse "a".
-	while (util_is_numeric(c = *str))
+	if (count == 2)
 	{
-		*a *= 10;
-		*a += (c - 0x30);
-
-		str++;
+		args->first = n[0];
+		args->step = 1;
+		args->last = n[1];
+	}
+	else if (count == 3)
+	{
+		args->first = n[0];
+		args->step = n[1];
+		args->last = n[2];
+	}
+	else
+	{
+		return false;
 	}
 
-	// Expecting space char next.
-	if (c != ' ')
+	return (args->step != 0);
+}
+
+static bool parse_number(const char** str, unsigned long* v)
+{
+	const char* s = *str;
+
+	if (!util_is_numeric(*s))
 	{
 		return false;
 	}
 
-	// Keep going until we run out of spaces.
-	while ((c = *str) == ' ')
+	*v = 0;
+	while (util_is_numeric(*s))
 	{
-		str++;
+		const unsigned char d = (*s - '0');
+
+		// Refuse anything above 4294967295.
+		if (*v > 429496729 || (*v == 429496729 && d > 5))
+		{
+			return false;
+		}
+
+		*v = (*v * 10) + d;
+		s++;
 	}
 
-	// Expecting numeric char next.
-	if (!util_is_numeric(c))
+	if (*s != ' ' && *s != 0x00)
 	{
 		return false;
 	}
 
-	// Parse "b".
-	while (util_is_numeric(c = *str))
-	{
-		*b *= 10;
-		*b += (c - 0x30);
+	*str = s;
 
-		str++;
+	return true;
+}
+
+// Returns the index of the first non-zero digit, keeping at least one digit.
+static unsigned char first_digit(const char* digits)
+{
+	unsigned char i = 0;
+	while (i < SEQ_DIGITS - 1 && digits[i] == '0')
+	{
+		i++;
 	}
 
-	return true;
+	return i;
+}
+
+static void write_sep(const seq_args_t* args)
+{
+	if (args->sep[0] == 0x00)
+	{
+		serial_write_newline();
+	}
+	else
+	{
+		serial_write(args->sep, strlen(args->sep));
+	}
 }
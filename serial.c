@@ -1,9 +1,11 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 
 #include "serial.h"
 
 #include "avr_mcu.h"
+#include "lz.h"
 #include "pm.h"
 #include "rng.h"
 #include "thread.h"
@@ -13,8 +15,7 @@
 	#error F_CPU not defined
 #endif
 
-#define BAUDRATE 38400
-#define UBRR (F_CPU / 16 / BAUDRATE)
+#define UBRR (F_CPU / 16 / SERIAL_BAUDRATE)
 
 static const unsigned char NEWLINE[2] = { 0x0d, 0x0a };
 
@@ -22,6 +23,16 @@ static const unsigned char NEWLINE[2] = { 0x0d, 0x0a };
 static volatile unsigned char _rx_buf[SERIAL_RX_BUF_SIZE];
 static volatile unsigned char _rx_buf_next_read = 0;
 static volatile unsigned char _rx_buf_next_write = 0;
+static volatile unsigned short _rx_drops = 0;
+
+// When set, output that would go to the USART is passed to this instead.
+static serial_tx_hook_t _tx_hook = 0;
+
+// Bytes written through serial_tx_byte(), modulo 2^16.
+static unsigned short _tx_count = 0;
+
+// When set, input is read from this instead of the USART.
+static serial_rx_hook_t _rx_hook = 0;
 
 
 static void serial_init_hw();
@@ -57,6 +68,7 @@ ISR(USART1_RX_vect)
 	unsigned char c = UDR;
 	if (((_rx_buf_next_write + 1) % SERIAL_RX_BUF_SIZE) == _rx_buf_next_read)
 	{
+		_rx_drops++;
 		return;
 	}
 
@@ -84,6 +96,11 @@ unsigned char serial_read_next_byte()
 		return thread_read_pipe();
 	}
 
+	if (_rx_hook != 0)
+	{
+		return _rx_hook();
+	}
+
 	while (!serial_has_next_byte())
 	{
 		pm_yield();
@@ -95,6 +112,20 @@ unsigned char serial_read_next_byte()
 	return c;
 }
 
+// Reads the same bytes serial_read_next_byte() would, but more than one at a
+// time when reading from a pipe. Returns the number of bytes read (at least 1).
+unsigned char serial_read_block(unsigned char* buf, unsigned char len)
+{
+	if (thread_is_running() && thread_which_is_running() == 1)
+	{
+		return thread_read_pipe_block(buf, len);
+	}
+
+	buf[0] = serial_read_next_byte();
+
+	return 1;
+}
+
 void serial_write(const unsigned char* data, short len)
 {
 	short i;
@@ -104,6 +135,16 @@ void serial_write(const unsigned char* data, short len)
 	}
 }
 
+// Writes a null-terminated string kept in flash (as from PSTR()).
+void serial_write_P(const char* s)
+{
+	unsigned char c;
+	while ((c = pgm_read_byte(s++)) != 0x00)
+	{
+		serial_tx_byte(c);
+	}
+}
+
 void serial_write_newline()
 {
 	serial_write(NEWLINE, sizeof(NEWLINE));
@@ -111,17 +152,73 @@ void serial_write_newline()
 
 void serial_tx_byte(unsigned char data)
 {
-	if (thread_is_running() && thread_which_is_running() == 0)
+	_tx_count++;
+
+	// Once the second thread has returned, the first one is no longer "0", and
+	// its output is dropped by thread_write_pipe().
+	if (thread_is_running() && thread_which_is_running() != 1)
 	{
 		thread_write_pipe(data);
 	}
+	else if (_tx_hook != 0)
+	{
+		_tx_hook(data);
+	}
+	else if (lz_is_on())
+	{
+		lz_write(data);
+	}
 	else
 	{
-		while (!(UCSRA & (1 << UDRE))) { }
-		UDR = data;
+		serial_tx_byte_direct(data);
 	}
 }
 
+// Writes straight to the UART, bypassing any pipe or TX hook.
+void serial_tx_byte_direct(unsigned char data)
+{
+	while (!(UCSRA & (1 << UDRE))) { }
+	UDR = data;
+}
+
+void serial_set_tx_hook(serial_tx_hook_t hook)
+{
+	_tx_hook = hook;
+}
+
+serial_tx_hook_t serial_get_tx_hook()
+{
+	return _tx_hook;
+}
+
+unsigned short serial_get_tx_count()
+{
+	return _tx_count;
+}
+
+void serial_set_rx_hook(serial_rx_hook_t hook)
+{
+	_rx_hook = hook;
+}
+
+serial_rx_hook_t serial_get_rx_hook()
+{
+	return _rx_hook;
+}
+
+// Number of bytes dropped so far because the RX buffer was full (wraps around).
+unsigned short serial_get_rx_drop_count()
+{
+	const unsigned char sreg = SREG;
+	cli();
+
+	const unsigned short n = _rx_drops;
+
+	SREG = sreg;
+
+	return n;
+}
+
 static void serial_init_hw()
 {
 #if (defined AVRSYSH_MCU_328P)
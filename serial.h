@@ -5,12 +5,26 @@
 
 #include "avr_mcu.h"
 
+#define SERIAL_BAUDRATE 38400
+
+typedef void (*serial_tx_hook_t)(unsigned char);
+typedef unsigned char (*serial_rx_hook_t)();
+
 void serial_init();
 bool serial_has_next_byte();
 unsigned char serial_read_next_byte();
+unsigned char serial_read_block(unsigned char* buf, unsigned char len);
 void serial_write(const unsigned char* data, short len);
+void serial_write_P(const char* s);
 void serial_write_newline();
 void serial_tx_byte(unsigned char data);
+void serial_tx_byte_direct(unsigned char data);
+void serial_set_tx_hook(serial_tx_hook_t hook);
+serial_tx_hook_t serial_get_tx_hook();
+unsigned short serial_get_tx_count();
+void serial_set_rx_hook(serial_rx_hook_t hook);
+serial_rx_hook_t serial_get_rx_hook();
+unsigned short serial_get_rx_drop_count();
 
 #ifdef SERIAL_EXTRA_SUPPORT
 void serial_extra_start();
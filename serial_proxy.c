@@ -2,18 +2,23 @@
 
 #ifdef SERIAL_EXTRA_SUPPORT
 
+#include <avr/pgmspace.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "lz.h"
 #include "pm.h"
 #include "serial.h"
 
-static const char* START_MSG = "Ctrl+G to stop";
+static const char START_MSG[] PROGMEM = "Ctrl+G to stop";
 
 void serialproxy()
 {
-	serial_write(START_MSG, strlen(START_MSG));
+	// The other USART's bytes are passed on as they are.
+	lz_off();
+
+	serial_write_P(START_MSG);
 	serial_write_newline();
 	serial_write_newline();
 
@@ -53,7 +58,7 @@ stop:
 	serial_extra_stop();
 
 	char buf[32];
-	sprintf(buf, "bytes: %u up, %u down", bytes_up, bytes_down);
+	sprintf_P(buf, PSTR("bytes: %u up, %u down"), bytes_up, bytes_down);
 	serial_write(buf, strlen(buf));
 	serial_write_newline();
 }
@@ -4,19 +4,25 @@
 #include "snake.h"
 #include "game.h"
 
+#include "avr_mcu.h"
 #include "draw.h"
+#include "render.h"
 #include "rng.h"
 #include "term.h"
 
 
-// WARNING: Odd values for width/height not tested and not likely to work as is!
-//          Additionally, these values must be chosen carefully to not run out of memory,
-//          as the map requires (SNAKE_WIDTH * SNAKE_HEIGHT / 2) bytes of memory
+// The board is SNAKE_WIDTH by SNAKE_HEIGHT, or on MCUs which allow a larger
+// one, the size of the terminal up to SNAKE_MAX_WIDTH by SNAKE_MAX_HEIGHT.
+//
+// The walls are found from the coordinates, so the map only covers the cells
+// inside them, at 2 bits each: 0 for a free cell, and otherwise the way the
+// snake turns on its way through the cell towards the head. The tail follows
+// the turns starting from its own direction, which is kept in snake_t.
 #define SNAKE_WIDTH 80
 #define SNAKE_HEIGHT 20
+#define SNAKE_MIN_WIDTH 20
+#define SNAKE_MIN_HEIGHT 10
 
-#define SNAKE_START_TAIL_X (SNAKE_WIDTH / 2 - 2)
-#define SNAKE_START_TAIL_Y (SNAKE_HEIGHT / 2)
 #define SNAKE_START_LEN 3
 
 #define WALL_C '#'
@@ -24,7 +30,7 @@
 #define FOOD_C '+'
 #define SPACE_C ' '
 #define CLEAR_C SPACE_C
-#define QUIT_C 'Q'
+#define QUIT_C GAME_QUIT_C
 
 #define KEY_UP_C 'w'
 #define KEY_DOWN_C 's'
@@ -32,21 +38,39 @@
 #define KEY_LEFT_C 'a'
 
 
-#define MAP_SNAKE_BIT 0x08
-#define MAP_WALL_BIT 0x04
-#define MAP_SNAKE_DIR_MASK 0x03
+#define MAP_FREE 0x00
+#define MAP_STRAIGHT 0x01
+#define MAP_RIGHT 0x02
+#define MAP_LEFT 0x03
 
+// Clockwise, so that turning right adds 1 and the horizontal directions are odd.
 #define SNAKE_DIR_UP 0x00
-#define SNAKE_DIR_DOWN 0x01
-#define SNAKE_DIR_RIGHT 0x02
+#define SNAKE_DIR_RIGHT 0x01
+#define SNAKE_DIR_DOWN 0x02
 #define SNAKE_DIR_LEFT 0x03
 
-#define SNAKE_DIR_AXIS_BIT 0x02
+#define SNAKE_DIR_AXIS_BIT 0x01
 
-#define MAX_FOOD_PLACE_ATTEMPTS 5
+// Food goes in a random cell until one is free while at least 1/4 of the
+// board is (so 4 tries are expected at most), and in the n-th free cell
+// counted from the start of the map after that.
+#define FOOD_RANDOM_MIN_FREE_SHIFT 2
 
 #define SNAKE_GAME_FPS 12
 
+// Glyphs, which are indices into GLYPHS.
+#define CLEAR_G 0
+#define SNAKE_G 1
+#define FOOD_G 2
+
+
+typedef struct
+{
+	unsigned char* cells;
+	unsigned char w;
+	unsigned char h;
+	unsigned short free;
+} snake_map_t;
 
 typedef struct
 {
@@ -57,6 +81,8 @@ typedef struct
 	short tail_prev_x;
 	short tail_prev_y;
 	unsigned char head_dir;
+	unsigned char move_dir;
+	unsigned char tail_dir;
 	bool grow;
 } snake_t;
 
@@ -69,22 +95,46 @@ typedef struct
 } food_t;
 
 
+static const render_glyph_t GLYPHS[] = {
+	{ CLEAR_C, DRAW_BG_RESET },
+	{ SNAKE_C, DRAW_BG_RESET },
+	{ FOOD_C, DRAW_BG_RESET }
+};
+
+
+static void get_board_size(unsigned char* w, unsigned char* h);
 static void snake_dir_change(snake_t* snake, unsigned char dir);
-static bool update_snake(snake_t* snake, food_t* food, unsigned char* map);
-static void update_food(food_t* food, unsigned char* map);
-static void draw_frame(snake_t* snake, food_t* food);
+static bool update_snake(snake_t* snake, food_t* food, snake_map_t* map);
+static void update_food(food_t* food, snake_map_t* map);
+static void draw_frame(render_t* r, snake_t* snake, food_t* food);
+static unsigned char map_get(const snake_map_t* map, short x, short y);
+static void map_set(snake_map_t* map, short x, short y, unsigned char v);
+static bool map_is_wall(const snake_map_t* map, short x, short y);
+static void move_pos(short* x, short* y, unsigned char dir);
 
 
 void snake_main()
 {
+	render_t render;
+	game_context_t ctx;
+	game_context_init(&ctx, SNAKE_GAME_FPS, &render, &snake_main);
+
+	unsigned char w;
+	unsigned char h;
+	get_board_size(&w, &h);
+
 	// Init snake.
+	const short start_x = w / 2 - 2;
+	const short start_y = h / 2;
 	snake_t snake = {
-		SNAKE_START_TAIL_X + SNAKE_START_LEN - 1,
-		SNAKE_START_TAIL_Y,
-		SNAKE_START_TAIL_X,
-		SNAKE_START_TAIL_Y,
-		SNAKE_START_TAIL_X - 1,
-		SNAKE_START_TAIL_Y,
+		start_x + SNAKE_START_LEN - 1,
+		start_y,
+		start_x,
+		start_y,
+		start_x - 1,
+		start_y,
+		SNAKE_DIR_RIGHT,
+		SNAKE_DIR_RIGHT,
 		SNAKE_DIR_RIGHT,
 		false
 	};
@@ -93,35 +143,18 @@ void snake_main()
 	food_t food = { 0, 0, false, false };
 
 	// Init map.
-	const unsigned short map_size = (SNAKE_WIDTH * SNAKE_HEIGHT) / 2;
-	unsigned char map[map_size];
-	memset(map, 0, map_size);
+	const unsigned short cells = (unsigned short)(w - 2) * (h - 2);
+	unsigned char map_cells[(cells + 3) >> 2];
+	memset(map_cells, 0, sizeof(map_cells));
 
-	// Place walls on map.
-	for (unsigned short i = 0; i < SNAKE_HEIGHT; i++)
-	{
-		unsigned short map_row_pos = i * SNAKE_WIDTH;
-
-		if (i == 0 || i == SNAKE_HEIGHT - 1)
-		{
-			// Top and bottom walls
-			memset(map + (map_row_pos >> 1), ((MAP_WALL_BIT << 4) | MAP_WALL_BIT), (SNAKE_WIDTH >> 1));
-		}
-		else
-		{
-			// Side walls
-			map[map_row_pos >> 1] |= (MAP_WALL_BIT << 4);
-			map[(map_row_pos + SNAKE_WIDTH - 1) >> 1] |= MAP_WALL_BIT;
-		}
-	}
+	snake_map_t map = { map_cells, w, h, cells };
 
 	// Place snake on map.
-	unsigned short snake_tail_map_pos = snake.tail_y * SNAKE_WIDTH + snake.tail_x;
 	for (short i = 0; i < SNAKE_START_LEN; i++)
 	{
-		unsigned short sh = (((snake_tail_map_pos + i) & 0x01) == 0x01 ? 0 : 4);
-		map[(snake_tail_map_pos + i) >> 1] |= ((MAP_SNAKE_BIT | SNAKE_DIR_RIGHT) << sh);
+		map_set(&map, start_x + i, start_y, MAP_STRAIGHT);
 	}
+	map.free -= SNAKE_START_LEN;
 
 
 	// Prepare for drawing on screen.
@@ -129,27 +162,29 @@ void snake_main()
 	term_clear_screen();
 
 	// Draw walls.
-	draw_border(SNAKE_WIDTH, SNAKE_HEIGHT, WALL_C);
+	draw_border(w, h, WALL_C);
+
+	// Everything inside the walls is drawn through the renderer.
+	unsigned char shadow[RENDER_SHADOW_SIZE(w - 2, h - 2)];
+	render_init(&render, shadow, 2, 2, w - 2, h - 2, GLYPHS);
 
 	// Draw snake.
-	draw_horizontal(snake.tail_x + 1, snake.tail_y + 1, SNAKE_START_LEN, SNAKE_C);
+	render_put_horizontal(&render, start_x + 1, start_y + 1, SNAKE_START_LEN, SNAKE_G);
 
+	render_frame(&render);
 	term_cursor_home();
 
 
-	game_context_t ctx;
-	game_context_init(&ctx, SNAKE_GAME_FPS);
-
 	unsigned char c = game_get_char(&ctx, true);
 	bool check = false;
 	while (1)
 	{
-		if (game_should_draw_frame(&ctx))
+		if (game_should_step(&ctx))
 		{
-			update_food(&food, map);
-			check = update_snake(&snake, &food, map);
-
-			draw_frame(&snake, &food);
+			update_food(&food, &map);
+			check = update_snake(&snake, &food, &map);
+			draw_frame(&render, &snake, &food);
+			game_draw(&ctx);
 		}
 
 		if (c == QUIT_C)
@@ -185,41 +220,49 @@ void snake_main()
 
 	term_clear_screen();
 	term_set_cursor(true);
+
+	game_context_end(&ctx);
 }
 
 
+static void get_board_size(unsigned char* w, unsigned char* h)
+{
+	*w = SNAKE_WIDTH;
+	*h = SNAKE_HEIGHT;
+
+#if (SNAKE_MAX_WIDTH > SNAKE_WIDTH) || (SNAKE_MAX_HEIGHT > SNAKE_HEIGHT)
+	short tw;
+	short th;
+	if (game_get_term_size(&tw, &th))
+	{
+		// The last row is left for the cursor.
+		th--;
+
+		*w = (tw < SNAKE_MIN_WIDTH ? SNAKE_MIN_WIDTH : (tw > SNAKE_MAX_WIDTH ? SNAKE_MAX_WIDTH : tw));
+		*h = (th < SNAKE_MIN_HEIGHT ? SNAKE_MIN_HEIGHT : (th > SNAKE_MAX_HEIGHT ? SNAKE_MAX_HEIGHT : th));
+	}
+#endif
+}
+
 static void snake_dir_change(snake_t* snake, unsigned char dir)
 {
-	// Only change direction if it's to a different axis than the current one.
-	if ((snake->head_dir & SNAKE_DIR_AXIS_BIT) != (dir & SNAKE_DIR_AXIS_BIT))
+	// Only change direction if it's to a different axis than the last move,
+	// so that two quick turns can't reverse the snake into itself.
+	if ((snake->move_dir & SNAKE_DIR_AXIS_BIT) != (dir & SNAKE_DIR_AXIS_BIT))
 	{
 		snake->head_dir = dir;
 	}
 }
 
-static bool update_snake(snake_t* snake, food_t* food, unsigned char* map)
+static bool update_snake(snake_t* snake, food_t* food, snake_map_t* map)
 {
-	unsigned short map_head_pos_prev = snake->head_y * SNAKE_WIDTH + snake->head_x;
+	// Leave the turn taken out of the current head cell.
+	const unsigned char turn = ((snake->head_dir - snake->move_dir) & 0x03);
+	map_set(map, snake->head_x, snake->head_y, (turn == 0 ? MAP_STRAIGHT : (turn == 1 ? MAP_RIGHT : MAP_LEFT)));
 
 	// Update head position.
-	switch (snake->head_dir)
-	{
-	case SNAKE_DIR_UP:
-		snake->head_y--;
-		break;
-	case SNAKE_DIR_DOWN:
-		snake->head_y++;
-		break;
-	case SNAKE_DIR_RIGHT:
-		snake->head_x++;
-		break;
-	case SNAKE_DIR_LEFT:
-		snake->head_x--;
-		break;
-	}
-
-	unsigned short map_head_pos = snake->head_y * SNAKE_WIDTH + snake->head_x;
-	unsigned short map_tail_pos = snake->tail_y * SNAKE_WIDTH + snake->tail_x;
+	move_pos(&snake->head_x, &snake->head_y, snake->head_dir);
+	snake->move_dir = snake->head_dir;
 
 	// Only update tail if the snake is not growing.
 	if (!snake->grow)
@@ -228,70 +271,34 @@ static bool update_snake(snake_t* snake, food_t* food, unsigned char* map)
 		snake->tail_prev_y = snake->tail_y;
 
 		// Update tail position.
-		unsigned char tail_dir;
-		if ((map_tail_pos & 0x01) == 0x01)
+		const unsigned char tail_turn = map_get(map, snake->tail_x, snake->tail_y);
+		if (tail_turn == MAP_RIGHT)
 		{
-			tail_dir = map[map_tail_pos >> 1] & MAP_SNAKE_DIR_MASK;
+			snake->tail_dir = ((snake->tail_dir + 1) & 0x03);
 		}
-		else
+		else if (tail_turn == MAP_LEFT)
 		{
-			tail_dir = (map[map_tail_pos >> 1] & (MAP_SNAKE_DIR_MASK << 4)) >> 4;
+			snake->tail_dir = ((snake->tail_dir - 1) & 0x03);
 		}
 
-		switch (tail_dir)
-		{
-		case SNAKE_DIR_UP:
-			snake->tail_y--;
-			break;
-		case SNAKE_DIR_DOWN:
-			snake->tail_y++;
-			break;
-		case SNAKE_DIR_RIGHT:
-			snake->tail_x++;
-			break;
-		case SNAKE_DIR_LEFT:
-			snake->tail_x--;
-			break;
-		}
+		map_set(map, snake->tail_x, snake->tail_y, MAP_FREE);
+		map->free++;
 
-		if ((map_tail_pos & 0x01) == 0x01)
-		{
-			map[map_tail_pos >> 1] &= 0xf0;
-		}
-		else
-		{
-			map[map_tail_pos >> 1] &= 0x0f;
-		}
+		move_pos(&snake->tail_x, &snake->tail_y, snake->tail_dir);
 	}
 	else
 	{
 		snake->grow = false;
 	}
 
-	unsigned char map_val;
-	if ((map_head_pos & 0x01) == 0x01)
-	{
-		map_val = map[map_head_pos >> 1] & 0x0f;
-	}
-	else
-	{
-		map_val = (map[map_head_pos >> 1] & 0xf0) >> 4;
-	}
-
-	if (map_val != 0)
+	if (map_is_wall(map, snake->head_x, snake->head_y) || map_get(map, snake->head_x, snake->head_y) != MAP_FREE)
 	{
 		// Snake has run into something.
 		return true;
 	}
 
-	if ((map_head_pos_prev & 0x01) == 0x01)
-	{
-		map[map_head_pos_prev >> 1] |= (MAP_SNAKE_BIT | snake->head_dir);
-	}
-	else
-	{
-		map[map_head_pos_prev >> 1] |= ((MAP_SNAKE_BIT | snake->head_dir) << 4);
-	}
+	map_set(map, snake->head_x, snake->head_y, MAP_STRAIGHT);
+	map->free--;
 
 	if (food->active && food->x == snake->head_x && food->y == snake->head_y)
 	{
@@ -303,41 +310,60 @@ static bool update_snake(snake_t* snake, food_t* food, unsigned char* map)
 	return false;
 }
 
-static void update_food(food_t* food, unsigned char* map)
+static void update_food(food_t* food, snake_map_t* map)
 {
-	if (food->active)
+	if (food->active || map->free == 0)
 	{
 		return;
 	}
 
 	if ((((unsigned short)rng_rand()) & 0x1f) == 0x00)
 	{
-		short attempts = 0;
-		for (; attempts < MAX_FOOD_PLACE_ATTEMPTS; attempts++)
-		{
-			food->x = (((unsigned short)rng_rand()) % (SNAKE_WIDTH - 2)) + 1;
-			food->y = (((unsigned short)rng_rand()) % (SNAKE_HEIGHT - 2)) + 1;
+		const unsigned char w = map->w - 2;
+		const unsigned char h = map->h - 2;
 
-			unsigned short map_pos = food->y * SNAKE_HEIGHT + food->x;
-			unsigned char map_val;
-			if ((map_pos & 0x01) == 0x01)
+		if (map->free >= (((unsigned short)w * h) >> FOOD_RANDOM_MIN_FREE_SHIFT))
+		{
+			do
 			{
-				map_val = map[map_pos >> 1] & 0x0f;
-			}
-			else
+				food->x = (((unsigned short)rng_rand()) % w) + 1;
+				food->y = (((unsigned short)rng_rand()) % h) + 1;
+			} while (map_get(map, food->x, food->y) != MAP_FREE);
+		}
+		else
+		{
+			unsigned short n = ((unsigned short)rng_rand()) % map->free;
+
+			// Whole bytes of the map are skipped by their free cell count first.
+			unsigned short pos = 0;
+			while (true)
 			{
-				map_val = (map[map_pos >> 1] & 0xf0) >> 4;
+				const unsigned char b = map->cells[pos >> 2];
+				const unsigned char free = ((b & 0x03) == 0) + ((b & 0x0c) == 0) + ((b & 0x30) == 0) + ((b & 0xc0) == 0);
+				if (n < free)
+				{
+					break;
+				}
+
+				n -= free;
+				pos += 4;
 			}
 
-			if (map_val == 0)
+			while (true)
 			{
-				break;
+				if (((map->cells[pos >> 2] >> ((pos & 0x03) << 1)) & 0x03) == MAP_FREE)
+				{
+					if (n == 0)
+					{
+						break;
+					}
+					n--;
+				}
+				pos++;
 			}
-		}
 
-		if (attempts == MAX_FOOD_PLACE_ATTEMPTS)
-		{
-			return;
+			food->x = (pos % w) + 1;
+			food->y = (pos / w) + 1;
 		}
 
 		food->active = true;
@@ -345,18 +371,57 @@ static void update_food(food_t* food, unsigned char* map)
 	}
 }
 
-static void draw_frame(snake_t* snake, food_t* food)
+static void draw_frame(render_t* r, snake_t* snake, food_t* food)
 {
-	// Draw snake head.
-	draw_horizontal(snake->head_x + 1, snake->head_y + 1, 1, SNAKE_C);
+	// Clear snake tail (first, as the head may have moved into it).
+	render_put(r, snake->tail_prev_x + 1, snake->tail_prev_y + 1, CLEAR_G);
 
-	// Clear snake tail.
-	draw_horizontal(snake->tail_prev_x + 1, snake->tail_prev_y + 1, 1, CLEAR_C);
+	// Draw snake head.
+	render_put(r, snake->head_x + 1, snake->head_y + 1, SNAKE_G);
 
 	// Draw food, if needed.
 	if (food->need_draw && food->active)
 	{
-		draw_horizontal(food->x + 1, food->y + 1, 1, FOOD_C);
+		render_put(r, food->x + 1, food->y + 1, FOOD_G);
 		food->need_draw = false;
 	}
 }
+
+// Cells are numbered from the top left inside the walls, 4 to a byte starting
+// from the low bits.
+static unsigned char map_get(const snake_map_t* map, short x, short y)
+{
+	const unsigned short pos = (unsigned short)(y - 1) * (map->w - 2) + (x - 1);
+	return ((map->cells[pos >> 2] >> ((pos & 0x03) << 1)) & 0x03);
+}
+
+static void map_set(snake_map_t* map, short x, short y, unsigned char v)
+{
+	const unsigned short pos = (unsigned short)(y - 1) * (map->w - 2) + (x - 1);
+	const unsigned char sh = ((pos & 0x03) << 1);
+	map->cells[pos >> 2] = ((map->cells[pos >> 2] & ~(0x03 << sh)) | (v << sh));
+}
+
+static bool map_is_wall(const snake_map_t* map, short x, short y)
+{
+	return (x <= 0 || y <= 0 || x >= map->w - 1 || y >= map->h - 1);
+}
+
+static void move_pos(short* x, short* y, unsigned char dir)
+{
+	switch (dir)
+	{
+	case SNAKE_DIR_UP:
+		(*y)--;
+		break;
+	case SNAKE_DIR_DOWN:
+		(*y)++;
+		break;
+	case SNAKE_DIR_RIGHT:
+		(*x)++;
+		break;
+	case SNAKE_DIR_LEFT:
+		(*x)--;
+		break;
+	}
+}
@@ -1,9 +1,12 @@
+#include <avr/interrupt.h>
+
 #include "sp_mon.h"
 
 #include "reg_mem.h"
 
 static volatile unsigned short _sp_buckets[SP_MON_NUM_BUCKETS];
 static volatile bool _enable = false;
+static volatile unsigned short _sp_low = 0xffff;
 
 
 void sp_mon_enable(bool enable)
@@ -21,12 +24,19 @@ void sp_mon_enable(bool enable)
 
 void sp_mon_check()
 {
+	unsigned short sp = REG_SP;
+
+	// The low-water mark is always tracked, as it only costs a compare.
+	if (sp < _sp_low)
+	{
+		_sp_low = sp;
+	}
+
 	if (!_enable)
 	{
 		return;
 	}
 
-	unsigned short sp = REG_SP;
 	_sp_buckets[sp >> SP_MON_BUCKET_SIZE_BITS]++;
 }
 
@@ -34,3 +44,17 @@ volatile unsigned short* sp_mon_get_buckets()
 {
 	return _sp_buckets;
 }
+
+// Returns the lowest SP seen by the timer interrupt since the last call.
+unsigned short sp_mon_take_low_water()
+{
+	const unsigned char sreg = SREG;
+	cli();
+
+	const unsigned short sp = _sp_low;
+	_sp_low = 0xffff;
+
+	SREG = sreg;
+
+	return sp;
+}
@@ -20,5 +20,7 @@ void sp_mon_check();
 
 volatile unsigned short* sp_mon_get_buckets();
 
+unsigned short sp_mon_take_low_water();
+
 
 #endif // _SP_MON_H_
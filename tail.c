@@ -0,0 +1,193 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tail.h"
+
+#include "avr_mcu.h"
+#include "serial.h"
+#include "util.h"
+
+// The last lines are kept in a ring of TAIL_BUF_SIZE bytes, each ended by a CR.
+// The oldest line is dropped when there are more than N, or when the ring is
+// full. A single line longer than the whole ring is cut short.
+
+#define TAIL_DEFAULT_LINES 10
+#define TAIL_EOL 0x0d
+
+
+typedef struct
+{
+	unsigned char buf[TAIL_BUF_SIZE];
+	unsigned short start;
+	unsigned short len;
+	unsigned short lines;
+} tail_ring_t;
+
+
+static bool parse_args(const char* str, unsigned short* n);
+static void ring_push(tail_ring_t* r, unsigned char c);
+static void ring_drop_line(tail_ring_t* r);
+
+
+void tail_main(void* arg)
+{
+	const char* str = (const char*) arg;
+	unsigned short n;
+
+	if (!parse_args(str, &n))
+	{
+		serial_write_P(PSTR("bad args"));
+		serial_write_newline();
+
+		return;
+	}
+
+	tail_ring_t r;
+	r.start = 0;
+	r.len = 0;
+	r.lines = 0;
+
+	// Length of the line not yet ended.
+	unsigned short partial = 0;
+
+	while (true)
+	{
+		unsigned char c = serial_read_next_byte();
+		if (c == 0x03)
+		{
+			return;
+		}
+		else if (c == 0x04)
+		{
+			break;
+		}
+		else if (c == 0x0a || n == 0)
+		{
+			continue;
+		}
+		else if (c == TAIL_EOL)
+		{
+			if (r.len == TAIL_BUF_SIZE && r.lines != 0)
+			{
+				ring_drop_line(&r);
+			}
+
+			ring_push(&r, TAIL_EOL);
+			r.lines++;
+			partial = 0;
+
+			if (r.lines > n)
+			{
+				ring_drop_line(&r);
+			}
+			continue;
+		}
+
+		if (r.len == TAIL_BUF_SIZE)
+		{
+			if (r.lines == 0)
+			{
+				// This line alone fills the ring.
+				continue;
+			}
+			ring_drop_line(&r);
+		}
+
+		ring_push(&r, c);
+		partial++;
+	}
+
+	// A last line without a line ending counts as one more.
+	if (partial != 0 && r.lines == n)
+	{
+		ring_drop_line(&r);
+	}
+
+	for (unsigned short i = 0; i < r.len; i++)
+	{
+		const unsigned char c = r.buf[(r.start + i) % TAIL_BUF_SIZE];
+		if (c == TAIL_EOL)
+		{
+			serial_write_newline();
+		}
+		else
+		{
+			serial_tx_byte(c);
+		}
+	}
+
+	if (partial != 0)
+	{
+		serial_write_newline();
+	}
+}
+
+static bool parse_args(const char* str, unsigned short* n)
+{
+	str += 4; // Skip the "tail" command at the beginning.
+
+	*n = TAIL_DEFAULT_LINES;
+
+	// Skip all spaces.
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (*str == 0x00)
+	{
+		return true;
+	}
+
+	if (str[0] != '-' || str[1] != 'n' || str[2] != ' ')
+	{
+		return false;
+	}
+	str += 3;
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (!util_parse_u16(&str, n))
+	{
+		return false;
+	}
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	return (*str == 0x00);
+}
+
+static void ring_push(tail_ring_t* r, unsigned char c)
+{
+	if (r->len == TAIL_BUF_SIZE)
+	{
+		// Only a line ending which alone fills the ring gets here, so the line is
+		// ended early instead.
+		r->buf[(r->start + r->len - 1) % TAIL_BUF_SIZE] = c;
+		return;
+	}
+
+	r->buf[(r->start + r->len) % TAIL_BUF_SIZE] = c;
+	r->len++;
+}
+
+static void ring_drop_line(tail_ring_t* r)
+{
+	unsigned char c;
+	do
+	{
+		c = r->buf[r->start];
+		r->start = ((r->start + 1) % TAIL_BUF_SIZE);
+		r->len--;
+	} while (c != TAIL_EOL && r->len != 0);
+
+	r->lines--;
+}
@@ -0,0 +1,6 @@
+#ifndef _TAIL_H_
+#define _TAIL_H_
+
+void tail_main(void* arg);
+
+#endif // _TAIL_H_
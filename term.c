@@ -1,37 +1,311 @@
-#include <stdio.h>
-#include <string.h>
+#include <avr/pgmspace.h>
 
 #include "term.h"
 
+#include "fmt.h"
+#include "pm.h"
 #include "serial.h"
+#include "timer.h"
+
+// The cursor position is tracked from the last move made here, so that the
+// next move can be relative to it when that is shorter. Anything written
+// other than through these functions changes the serial TX count, which is
+// how the position is known to be stale.
+//
+// Relative moves assume that LF only moves down a row (which is the VT100
+// default), and positions past TERM_WIDTH are not tracked, since the cursor
+// stays in the last column there until the next char is written.
+
+#define TERM_WIDTH 80
+
+// A relative move is at most a vertical move of "ESC[nnnnnB" and a horizontal
+// one of CR plus "ESC[nnnnnC".
+#define TERM_MOVE_MAX_LEN 20
+
+// How long to wait for the reply to a cursor position report.
+#define TERM_REPORT_TICKS (TIMER_TICKS_PER_SECOND / 4)
+
+
+static short _x;
+static short _y;
+static bool _known = false;
+static unsigned short _tx_mark;
+
+
+static unsigned char fmt_move(char* buf, short x, short y);
+static unsigned char fmt_relative(char* buf, short x, short y);
+static unsigned char fmt_csi(char* buf, unsigned short n, char f);
+static unsigned char fmt_repeat(char* buf, unsigned short n, char c);
+static unsigned char csi_len(unsigned short n);
+static bool is_known();
+static void set_known(short x, short y);
+
 
 void term_set_cursor(bool enable)
 {
-	serial_write("\e[?25", 5);
+	term_write_control((enable ? "\e[?25h" : "\e[?25l"), 6);
+}
+
+void term_cursor_home()
+{
+	serial_write_P(PSTR("\e[H"));
+	set_known(1, 1);
+}
+
+// Returns the number of bytes written, which is 0 if the cursor is already there.
+unsigned char term_move_cursor(short x, short y)
+{
+	char buf[TERM_MOVE_MAX_LEN];
+	const unsigned char len = fmt_move(buf, x, y);
+
+	serial_write(buf, len);
+	set_known(x, y);
+
+	return len;
+}
+
+// The number of bytes term_move_cursor() would write for the same move.
+unsigned char term_move_cost(short x, short y)
+{
+	char buf[TERM_MOVE_MAX_LEN];
+	return fmt_move(buf, x, y);
+}
+
+bool term_get_cursor(short* x, short* y)
+{
+	if (!is_known())
+	{
+		return false;
+	}
+
+	*x = _x;
+	*y = _y;
+
+	return true;
+}
+
+// Writes chars which move the cursor one column to the right each.
+void term_write(const char* buf, unsigned char len)
+{
+	const bool known = is_known();
+
+	serial_write(buf, len);
 
-	if (enable)
+	if (known)
 	{
-		serial_tx_byte('h');
+		set_known(_x + len, _y);
 	}
-	else
+}
+
+// Writes a sequence which leaves the cursor where it is (like SGR).
+void term_write_control(const char* buf, unsigned char len)
+{
+	const bool known = is_known();
+
+	serial_write(buf, len);
+
+	if (known)
 	{
-		serial_tx_byte('l');
+		set_known(_x, _y);
 	}
 }
 
-void term_cursor_home()
+void term_clear_screen()
 {
-	serial_write("\e[H", 3);
+	serial_write_P(PSTR("\e[2J\e[H"));
+	set_known(1, 1);
 }
 
-void term_move_cursor(short x, short y)
+// Moves the cursor as far as the terminal lets it, and asks where it ended up
+// ("ESC[6n", answered with "ESC[rows;colsR"). Other bytes received meanwhile
+// are dropped, and false is returned if no answer comes.
+bool term_get_size(short* w, short* h)
 {
-	char buf[12];
-	sprintf(buf, "\e[%u;%uH", y, x);
-	serial_write(buf, strlen(buf));
+	serial_write_P(PSTR("\e[999;999H\e[6n"));
+	_known = false;
+
+	unsigned short t[2];
+	timer_get_tick_count(t);
+	const unsigned short t0 = t[1];
+
+	unsigned short v[2] = { 0, 0 };
+	unsigned char state = 0;
+
+	while (true)
+	{
+		while (!serial_has_next_byte())
+		{
+			timer_get_tick_count(t);
+			if ((unsigned short)(t[1] - t0) >= TERM_REPORT_TICKS)
+			{
+				return false;
+			}
+
+			pm_yield();
+		}
+
+		const unsigned char c = serial_read_next_byte();
+
+		if (c == '\e')
+		{
+			state = 1;
+		}
+		else if (state == 1 && c == '[')
+		{
+			v[0] = 0;
+			v[1] = 0;
+			state = 2;
+		}
+		else if (state >= 2 && c >= '0' && c <= '9' && v[state - 2] < 1000)
+		{
+			v[state - 2] = v[state - 2] * 10 + (c - '0');
+		}
+		else if (state == 2 && c == ';')
+		{
+			state = 3;
+		}
+		else if (state == 3 && c == 'R')
+		{
+			*w = v[1];
+			*h = v[0];
+			return true;
+		}
+		else
+		{
+			state = 0;
+		}
+	}
 }
 
-void term_clear_screen()
+
+static unsigned char fmt_move(char* buf, short x, short y)
+{
+	unsigned char len = 2;
+	buf[0] = '\e';
+	buf[1] = '[';
+
+	// "ESC[H" and "ESC[yH" leave out a 1 for the column (and row).
+	if (x != 1 || y != 1)
+	{
+		len += fmt_u16(buf + len, y);
+	}
+	if (x != 1)
+	{
+		buf[len++] = ';';
+		len += fmt_u16(buf + len, x);
+	}
+	buf[len++] = 'H';
+
+	if (is_known())
+	{
+		char rel[TERM_MOVE_MAX_LEN];
+		const unsigned char rel_len = fmt_relative(rel, x, y);
+
+		if (rel_len < len)
+		{
+			for (unsigned char i = 0; i < rel_len; i++)
+			{
+				buf[i] = rel[i];
+			}
+			len = rel_len;
+		}
+	}
+
+	return len;
+}
+
+// Rows and columns are moved separately, as LF, CUU and CUD keep the column.
+static unsigned char fmt_relative(char* buf, short x, short y)
+{
+	unsigned char len = 0;
+
+	if (y > _y)
+	{
+		const unsigned short n = y - _y;
+		len += (n < csi_len(n) ? fmt_repeat(buf, n, '\n') : fmt_csi(buf, n, 'B'));
+	}
+	else if (y < _y)
+	{
+		len += fmt_csi(buf, _y - y, 'A');
+	}
+
+	if (x > _x)
+	{
+		len += fmt_csi(buf + len, x - _x, 'C');
+	}
+	else if (x < _x)
+	{
+		const unsigned short n = _x - x;
+
+		// Back n columns, or to column 1 and then forward again.
+		const unsigned char back_len = (n < csi_len(n) ? n : csi_len(n));
+		const unsigned char cr_len = 1 + (x == 1 ? 0 : csi_len(x - 1));
+
+		if (cr_len < back_len)
+		{
+			buf[len++] = '\r';
+			if (x != 1)
+			{
+				len += fmt_csi(buf + len, x - 1, 'C');
+			}
+		}
+		else if (n < csi_len(n))
+		{
+			len += fmt_repeat(buf + len, n, '\b');
+		}
+		else
+		{
+			len += fmt_csi(buf + len, n, 'D');
+		}
+	}
+
+	return len;
+}
+
+// "ESC[n" and then f, leaving out n when it is 1.
+static unsigned char fmt_csi(char* buf, unsigned short n, char f)
+{
+	unsigned char len = 2;
+	buf[0] = '\e';
+	buf[1] = '[';
+	if (n != 1)
+	{
+		len += fmt_u16(buf + len, n);
+	}
+	buf[len++] = f;
+
+	return len;
+}
+
+static unsigned char fmt_repeat(char* buf, unsigned short n, char c)
+{
+	for (unsigned short i = 0; i < n; i++)
+	{
+		buf[i] = c;
+	}
+
+	return n;
+}
+
+static unsigned char csi_len(unsigned short n)
+{
+	if (n == 1)
+	{
+		return 3;
+	}
+
+	return (n < 10 ? 4 : (n < 100 ? 5 : (n < 1000 ? 6 : (n < 10000 ? 7 : 8))));
+}
+
+static bool is_known()
+{
+	return (_known && serial_get_tx_count() == _tx_mark);
+}
+
+static void set_known(short x, short y)
 {
-	serial_write("\e[2J\e[H", 7);
+	_x = x;
+	_y = y;
+	_known = (x >= 1 && x <= TERM_WIDTH && y >= 1);
+	_tx_mark = serial_get_tx_count();
 }
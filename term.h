@@ -5,7 +5,12 @@
 
 void term_set_cursor(bool enable);
 void term_cursor_home();
-void term_move_cursor(short x, short y);
+unsigned char term_move_cursor(short x, short y);
+unsigned char term_move_cost(short x, short y);
+bool term_get_cursor(short* x, short* y);
+void term_write(const char* buf, unsigned char len);
+void term_write_control(const char* buf, unsigned char len);
 void term_clear_screen();
+bool term_get_size(short* w, short* h);
 
 #endif // _TERM_H_
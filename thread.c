@@ -209,6 +209,39 @@ unsigned char thread_read_pipe()
 	return c;
 }
 
+// Like thread_read_pipe(), but takes as many of the waiting bytes as fit in buf
+// at once, and returns how many were taken.
+unsigned char thread_read_pipe_block(unsigned char* buf, unsigned char len)
+{
+	while (!thread_pipe_has_next_byte())
+	{
+		if (_pipe_in_end)
+		{
+			buf[0] = 0x04;
+			return 1;
+		}
+
+		pm_yield();
+	}
+
+	unsigned char n = 0;
+	unsigned char r = _pipe_buf_next_read;
+	while (r != _pipe_buf_next_write && n < len)
+	{
+		buf[n++] = _pipe_buf[r];
+		r = ((r + 1) % THREAD_PIPE_BUF_SIZE);
+	}
+	_pipe_buf_next_read = r;
+
+	return n;
+}
+
+// True once the second thread has returned, so nothing more will be read.
+bool thread_is_pipe_closed()
+{
+	return is_returned_from_thread();
+}
+
 bool thread_is_pipe_full()
 {
 	return (((_pipe_buf_next_write + 1) % THREAD_PIPE_BUF_SIZE) == _pipe_buf_next_read);
@@ -14,7 +14,9 @@ unsigned short thread_switch_count();
 
 bool thread_pipe_has_next_byte();
 unsigned char thread_read_pipe();
+unsigned char thread_read_pipe_block(unsigned char* buf, unsigned char len);
 bool thread_is_pipe_full();
+bool thread_is_pipe_closed();
 void thread_write_pipe(unsigned char c);
 
 #endif // _THREAD_H_
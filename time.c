@@ -1,3 +1,4 @@
+#include <avr/pgmspace.h>
 #include <stdio.h>
 
 #include "time.h"
@@ -70,7 +71,7 @@ void time_get_time(char* str)
 {
 	if (!_set)
 	{
-		sprintf(str, "not set");
+		sprintf_P(str, PSTR("not set"));
 		return;
 	}
 
@@ -10,7 +10,6 @@
 
 
 static volatile unsigned short _t[2] = { 0, 0 };
-static volatile bool _t_updated = false;
 
 static volatile unsigned char _sleep_counter[2] = { 0, 0 };
 
@@ -28,7 +27,6 @@ ISR(TIMER1_OVF_vect)
 	{
 		_t[0]++;
 	}
-	_t_updated = true;
 
 	_sleep_counter[0]++;
 	_sleep_counter[1] += (SMCR & 0x01);
@@ -71,13 +69,34 @@ void timer_init()
 
 void timer_get_tick_count(unsigned short t[2])
 {
-	while (_t_updated)
-	{
-		_t_updated = false;
+	// Always fills in t, with both halves from the same tick.
+	const unsigned char sreg = SREG;
+	cli();
+
+	t[0] = _t[0];
+	t[1] = _t[1];
+
+	SREG = sreg;
+}
+
+// CPU cycles since boot, wrapping around every 2^32 cycles.
+unsigned long timer_get_cycles()
+{
+	const unsigned char sreg = SREG;
+	cli();
 
-		t[0] = _t[0];
-		t[1] = _t[1];
+	const unsigned short lo = TCNT1;
+	unsigned short hi = _t[1];
+
+	// Account for an overflow which is still waiting for its interrupt.
+	if ((TIFR1 & (1 << TOV1)) != 0 && lo < 0x8000)
+	{
+		hi++;
 	}
+
+	SREG = sreg;
+
+	return (((unsigned long)hi << 16) | lo);
 }
 
 unsigned char timer_get_tick_count_lsbyte()
@@ -158,6 +177,24 @@ bool timer_notify_register(timer_notify_t* tn)
 	return false;
 }
 
+void timer_notify_unregister(timer_notify_t* tn)
+{
+	// Don't let the timer interrupt see a partially cleared entry.
+	const unsigned char sreg = SREG;
+	cli();
+
+	short i;
+	for (i = 0; i < NOTIFY_COUNT_LIMIT; i++)
+	{
+		if (_notify_items[i] == tn)
+		{
+			_notify_items[i] = 0;
+		}
+	}
+
+	SREG = sreg;
+}
+
 unsigned short timer_get_notify_registered_count()
 {
 	unsigned short n = 0;
@@ -12,6 +12,7 @@
 
 void timer_init();
 void timer_get_tick_count(unsigned short t[2]);
+unsigned long timer_get_cycles();
 unsigned char timer_get_tick_count_lsbyte();
 short timer_compare(volatile unsigned short t0[2], volatile unsigned short t1[2]);
 void timer_add_seconds(unsigned short t0[2], unsigned short seconds);
@@ -24,6 +25,7 @@ typedef struct {
 } timer_notify_t;
 
 bool timer_notify_register(timer_notify_t* tn);
+void timer_notify_unregister(timer_notify_t* tn);
 unsigned short timer_get_notify_registered_count();
 
 
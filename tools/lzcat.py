@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+#
+# Decodes avrsysh's compressed output ("lz on", see lz.c), passing everything
+# outside of a compressed stream through unchanged.
+#
+# Usage: lzcat.py [-w WINDOW_BITS] [-l LENGTH_BITS] [FILE]
+#
+# The defaults match the 328P and 32U4 (-w 8 -l 4); use -w 10 -l 5 for the
+# 2560. FILE can be a serial device (already set to 38400 baud, e.g. with
+# "stty -F /dev/ttyUSB0 38400 raw"), and defaults to standard input.
+
+import argparse
+import sys
+
+START = b"\x1bLZ"
+MIN_MATCH = 2
+MARK_FLUSH = 0
+MARK_END = 1
+
+
+class Decoder:
+    def __init__(self, window_bits, length_bits, out):
+        self.window_bits = window_bits
+        self.length_bits = length_bits
+        self.out = out
+        self.reset()
+
+    def reset(self):
+        self.raw = True
+        self.matched = 0
+        self.bits = 0
+        self.bit_count = 0
+        self.history = bytearray()
+
+    def feed(self, data):
+        for b in data:
+            if self.raw:
+                self.feed_raw(b)
+            else:
+                self.bits = (self.bits << 8) | b
+                self.bit_count += 8
+                self.decode()
+
+    def feed_raw(self, b):
+        if b == START[self.matched]:
+            self.matched += 1
+            if self.matched == len(START):
+                self.raw = False
+                self.matched = 0
+            return
+
+        # Not a start after all, so the bytes held back were just output.
+        self.out.write(START[:self.matched])
+        self.matched = 0
+        if b == START[0]:
+            self.matched = 1
+        else:
+            self.out.write(bytes([b]))
+
+    def take(self, n):
+        self.bit_count -= n
+        v = (self.bits >> self.bit_count) & ((1 << n) - 1)
+        self.bits &= (1 << self.bit_count) - 1
+        return v
+
+    def decode(self):
+        ref_bits = 1 + self.window_bits + self.length_bits
+
+        while self.bit_count > 0:
+            if (self.bits >> (self.bit_count - 1)) & 1:
+                if self.bit_count < 9:
+                    return
+                self.take(1)
+                self.emit(bytes([self.take(8)]))
+                continue
+
+            if self.bit_count < ref_bits:
+                return
+            self.take(1)
+            dist = self.take(self.window_bits)
+            n = self.take(self.length_bits)
+
+            if dist != 0:
+                # The copy can overlap the bytes it is writing.
+                for _ in range(n + MIN_MATCH):
+                    self.emit(bytes([self.history[-dist]]))
+                continue
+
+            # A marker, followed by padding up to the next byte.
+            self.take(self.bit_count % 8)
+            if n == MARK_END:
+                rest = self.bits.to_bytes(self.bit_count // 8, "big")
+                self.reset()
+                self.feed(rest)
+                return
+
+        self.out.flush()
+
+    def emit(self, data):
+        self.out.write(data)
+        self.history += data
+        del self.history[:-(1 << self.window_bits)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode avrsysh compressed output.")
+    parser.add_argument("-w", "--window-bits", type=int, default=8)
+    parser.add_argument("-l", "--length-bits", type=int, default=4)
+    parser.add_argument("file", nargs="?")
+    args = parser.parse_args()
+
+    src = open(args.file, "rb", buffering=0) if args.file else sys.stdin.buffer
+    dec = Decoder(args.window_bits, args.length_bits, sys.stdout.buffer)
+
+    while True:
+        data = src.read1(256) if hasattr(src, "read1") else src.read(256)
+        if not data:
+            break
+        dec.feed(data)
+        sys.stdout.buffer.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,243 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tr.h"
+
+#include "serial.h"
+
+// Sets are kept as up to TR_MAX_RANGES ranges of chars, rather than expanded,
+// with a 256-bit map of the chars in the first set. A byte not in the map is
+// passed through after a single bit test, and only the others have to look up
+// their position in the ranges.
+//
+// In a set, "a-z" is a range, and "\r", "\n", "\t", "\s" (space) and "\\" are
+// escapes. When the second set is shorter, its last char is repeated.
+
+#define TR_MAX_RANGES 8
+#define TR_BLOCK_SIZE 16
+
+
+typedef struct
+{
+	unsigned char lo[TR_MAX_RANGES];
+	unsigned char hi[TR_MAX_RANGES];
+	unsigned char count;
+} tr_set_t;
+
+typedef struct
+{
+	tr_set_t from;
+	tr_set_t to;
+	unsigned char member[32];
+	bool del;
+} tr_t;
+
+
+static bool parse_args(const char* str, tr_t* tr);
+static bool parse_set(const char** str, tr_set_t* set);
+static unsigned char parse_set_char(const char** str);
+static unsigned char translate(const tr_t* tr, unsigned char c);
+
+
+void tr_main(void* arg)
+{
+	const char* str = (const char*) arg;
+	tr_t tr;
+
+	if (!parse_args(str, &tr))
+	{
+		serial_write_P(PSTR("bad args"));
+		serial_write_newline();
+
+		return;
+	}
+
+	unsigned char block[TR_BLOCK_SIZE];
+	while (true)
+	{
+		const unsigned char n = serial_read_block(block, sizeof(block));
+
+		for (unsigned char i = 0; i < n; i++)
+		{
+			unsigned char c = block[i];
+
+			if (c == 0x03 || c == 0x04)
+			{
+				return;
+			}
+
+			if ((tr.member[c >> 3] & (1 << (c & 0x07))) != 0)
+			{
+				if (tr.del)
+				{
+					continue;
+				}
+				c = translate(&tr, c);
+			}
+
+			serial_tx_byte(c);
+		}
+	}
+}
+
+static bool parse_args(const char* str, tr_t* tr)
+{
+	str += 2; // Skip the "tr" command at the beginning.
+
+	tr->del = false;
+	tr->to.count = 0;
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (str[0] == '-' && str[1] == 'd' && str[2] == ' ')
+	{
+		tr->del = true;
+		str += 3;
+
+		while (*str == ' ')
+		{
+			str++;
+		}
+	}
+
+	if (!parse_set(&str, &tr->from))
+	{
+		return false;
+	}
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (!tr->del && !parse_set(&str, &tr->to))
+	{
+		return false;
+	}
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (*str != 0x00)
+	{
+		return false;
+	}
+
+	memset(tr->member, 0, sizeof(tr->member));
+	for (unsigned char i = 0; i < tr->from.count; i++)
+	{
+		unsigned char c = tr->from.lo[i];
+		do
+		{
+			tr->member[c >> 3] |= (1 << (c & 0x07));
+		} while (c++ != tr->from.hi[i]);
+	}
+
+	return true;
+}
+
+static bool parse_set(const char** str, tr_set_t* set)
+{
+	const char* s = *str;
+
+	set->count = 0;
+
+	while (*s != ' ' && *s != 0x00)
+	{
+		if (set->count == TR_MAX_RANGES)
+		{
+			return false;
+		}
+
+		const unsigned char lo = parse_set_char(&s);
+		unsigned char hi = lo;
+
+		if (*s == '-' && s[1] != ' ' && s[1] != 0x00)
+		{
+			s++;
+			hi = parse_set_char(&s);
+			if (hi < lo)
+			{
+				return false;
+			}
+		}
+
+		set->lo[set->count] = lo;
+		set->hi[set->count] = hi;
+		set->count++;
+	}
+
+	*str = s;
+
+	return (set->count != 0);
+}
+
+static unsigned char parse_set_char(const char** str)
+{
+	const char* s = *str;
+	unsigned char c = *s++;
+
+	if (c == '\\' && *s != ' ' && *s != 0x00)
+	{
+		switch (*s++)
+		{
+		case 'r':
+			c = '\r';
+			break;
+		case 'n':
+			c = '\n';
+			break;
+		case 't':
+			c = '\t';
+			break;
+		case 's':
+			c = ' ';
+			break;
+		default:
+			c = s[-1];
+			break;
+		}
+	}
+
+	*str = s;
+
+	return c;
+}
+
+static unsigned char translate(const tr_t* tr, unsigned char c)
+{
+	// Position of c in the first set; if c is in it more than once, the last
+	// one wins.
+	unsigned short pos = 0;
+	unsigned short base = 0;
+	for (unsigned char i = 0; i < tr->from.count; i++)
+	{
+		const unsigned char lo = tr->from.lo[i];
+		const unsigned char hi = tr->from.hi[i];
+
+		if (c >= lo && c <= hi)
+		{
+			pos = base + (c - lo);
+		}
+		base += (hi - lo) + 1;
+	}
+
+	for (unsigned char i = 0; i < tr->to.count; i++)
+	{
+		const unsigned short len = (tr->to.hi[i] - tr->to.lo[i]) + 1;
+		if (pos < len)
+		{
+			return (tr->to.lo[i] + pos);
+		}
+		pos -= len;
+	}
+
+	return tr->to.hi[tr->to.count - 1];
+}
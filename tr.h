@@ -0,0 +1,6 @@
+#ifndef _TR_H_
+#define _TR_H_
+
+void tr_main(void* arg);
+
+#endif // _TR_H_
@@ -0,0 +1,226 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "uniq.h"
+
+#include "fmt.h"
+#include "serial.h"
+
+// Each line is reduced to a hash as it is read, and adjacent lines are
+// compared by hash and length. Only the first UNIQ_HOLD_SIZE bytes of a line are
+// kept (and compared as well), to be written out; longer lines are written
+// truncated, with "...", but are still compared in full by their hash.
+//
+// A run of equal lines is written once it has ended, so that -c can put the
+// count in front of it.
+
+#define UNIQ_HOLD_SIZE 48
+
+#define OPT_COUNT 0x01
+#define OPT_REPEATED 0x02
+
+
+typedef struct
+{
+	unsigned char hold[UNIQ_HOLD_SIZE];
+	unsigned short len;
+	unsigned long hash;
+} uniq_line_t;
+
+
+static bool parse_args(const char* str, unsigned char* opts);
+static void line_begin(uniq_line_t* line);
+static void line_add(uniq_line_t* line, unsigned char c);
+static bool line_equals(const uniq_line_t* a, const uniq_line_t* b);
+static void write_run(const uniq_line_t* line, unsigned short count, unsigned char opts);
+
+
+void uniq_main(void* arg)
+{
+	const char* str = (const char*) arg;
+	unsigned char opts;
+
+	if (!parse_args(str, &opts))
+	{
+		serial_write_P(PSTR("bad args"));
+		serial_write_newline();
+
+		return;
+	}
+
+	uniq_line_t lines[2];
+	unsigned char prev = 0;
+	unsigned short count = 0;
+	bool in_line = false;
+
+	line_begin(&lines[1]);
+
+	while (true)
+	{
+		unsigned char c = serial_read_next_byte();
+		if (c == 0x03)
+		{
+			return;
+		}
+		else if (c == 0x0a)
+		{
+			continue;
+		}
+		else if (c != 0x0d && c != 0x04)
+		{
+			line_add(&lines[prev ^ 1], c);
+			in_line = true;
+			continue;
+		}
+
+		// A line has ended (or a last one without a line ending).
+		if (c == 0x0d || in_line)
+		{
+			uniq_line_t* cur = &lines[prev ^ 1];
+
+			if (count != 0 && line_equals(cur, &lines[prev]))
+			{
+				if (count != 0xffff)
+				{
+					count++;
+				}
+			}
+			else
+			{
+				if (count != 0)
+				{
+					write_run(&lines[prev], count, opts);
+				}
+
+				prev ^= 1;
+				count = 1;
+			}
+
+			line_begin(&lines[prev ^ 1]);
+			in_line = false;
+		}
+
+		if (c == 0x04)
+		{
+			break;
+		}
+	}
+
+	if (count != 0)
+	{
+		write_run(&lines[prev], count, opts);
+	}
+}
+
+static bool parse_args(const char* str, unsigned char* opts)
+{
+	str += 4; // Skip the "uniq" command at the beginning.
+
+	*opts = 0;
+
+	while (*str != 0x00)
+	{
+		// Next char must be a space.
+		if (*str != ' ')
+		{
+			return false;
+		}
+
+		// Skip all remaining spaces.
+		while (*str == ' ')
+		{
+			str++;
+		}
+
+		if (*str == 0x00)
+		{
+			break;
+		}
+
+		if (*str != '-')
+		{
+			return false;
+		}
+
+		for (str++; *str != ' ' && *str != 0x00; str++)
+		{
+			switch (*str)
+			{
+			case 'c':
+				*opts |= OPT_COUNT;
+				break;
+			case 'd':
+				*opts |= OPT_REPEATED;
+				break;
+			default:
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void line_begin(uniq_line_t* line)
+{
+	line->len = 0;
+	line->hash = 0;
+}
+
+static void line_add(uniq_line_t* line, unsigned char c)
+{
+	if (line->len < UNIQ_HOLD_SIZE)
+	{
+		line->hold[line->len] = c;
+	}
+
+	if (line->len != 0xffff)
+	{
+		line->len++;
+	}
+
+	// h * 31 + c, with the multiply as a shift and a subtract.
+	line->hash = ((line->hash << 5) - line->hash) + c;
+}
+
+static bool line_equals(const uniq_line_t* a, const uniq_line_t* b)
+{
+	if (a->len != b->len || a->hash != b->hash)
+	{
+		return false;
+	}
+
+	const unsigned short n = (a->len < UNIQ_HOLD_SIZE ? a->len : UNIQ_HOLD_SIZE);
+
+	return (memcmp(a->hold, b->hold, n) == 0);
+}
+
+static void write_run(const uniq_line_t* line, unsigned short count, unsigned char opts)
+{
+	if ((opts & OPT_REPEATED) != 0 && count == 1)
+	{
+		return;
+	}
+
+	if ((opts & OPT_COUNT) != 0)
+	{
+		char buf[8];
+		unsigned char len = fmt_u16_pad(buf, count, 6, ' ');
+		buf[len++] = ' ';
+		serial_write(buf, len);
+	}
+
+	if (line->len <= UNIQ_HOLD_SIZE)
+	{
+		serial_write(line->hold, line->len);
+	}
+	else
+	{
+		serial_write(line->hold, UNIQ_HOLD_SIZE);
+		serial_write_P(PSTR("..."));
+	}
+
+	serial_write_newline();
+}
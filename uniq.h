@@ -0,0 +1,6 @@
+#ifndef _UNIQ_H_
+#define _UNIQ_H_
+
+void uniq_main(void* arg);
+
+#endif // _UNIQ_H_
@@ -4,3 +4,37 @@ bool util_is_numeric(char c)
 {
 	return (c >= '0' && c <= '9');
 }
+
+char util_to_lower(char c)
+{
+	return ((c >= 'A' && c <= 'Z') ? (c + ('a' - 'A')) : c);
+}
+
+// Parses a decimal number at *str, and moves *str past it. Fails if there are
+// no digits, or if the number does not fit.
+bool util_parse_u16(const char** str, unsigned short* v)
+{
+	const char* s = *str;
+
+	if (!util_is_numeric(*s))
+	{
+		return false;
+	}
+
+	unsigned long n = 0;
+	while (util_is_numeric(*s))
+	{
+		n = (n * 10) + (*s - '0');
+		if (n > 0xffff)
+		{
+			return false;
+		}
+
+		s++;
+	}
+
+	*v = n;
+	*str = s;
+
+	return true;
+}
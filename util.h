@@ -4,5 +4,7 @@
 #include <stdbool.h>
 
 bool util_is_numeric(char c);
+char util_to_lower(char c);
+bool util_parse_u16(const char** str, unsigned short* v);
 
 #endif // _UTIL_H_
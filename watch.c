@@ -0,0 +1,287 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "watch.h"
+
+#include "avr_mcu.h"
+#include "command.h"
+#include "pm.h"
+#include "rbuf.h"
+#include "serial.h"
+#include "term.h"
+#include "timer.h"
+#include "util.h"
+
+// The command's output is captured into a screen kept in a RAM buffer (see
+// rbuf.c) borrowed while watch runs, with as many rows of WATCH_COLS as fit.
+// Each char which differs from the last time is drawn as soon as it is
+// captured, so nothing but the screen has to be kept.
+
+#define WATCH_DEFAULT_INTERVAL 2
+#define WATCH_ROWS (RBUF_SIZE / WATCH_COLS)
+
+// Screen row of the first line of command output.
+#define WATCH_TOP_Y 3
+
+#define QUIT_C 'q'
+#define ABORT_C 0x03
+
+
+typedef struct
+{
+	unsigned char* screen;
+	unsigned char x;
+	unsigned char y;
+	unsigned char row_end;
+	bool esc;
+
+	// Where the last char drawn left the cursor.
+	unsigned char draw_x;
+	unsigned char draw_y;
+} watch_capture_t;
+
+static watch_capture_t _cap;
+
+
+static bool parse_args(const char* str, unsigned short* interval, const char** cmd);
+static void capture_byte(unsigned char c);
+static void capture_end();
+static void blank_row(unsigned char y, unsigned char x);
+static void set_char(unsigned char x, unsigned char y, unsigned char c);
+static bool wait_for_next(timer_notify_t* notify, unsigned short interval);
+
+
+void watch_main(const char* str)
+{
+	unsigned short interval;
+	const char* cmd;
+
+	if (!parse_args(str, &interval, &cmd))
+	{
+		serial_write_P(PSTR("bad args"));
+		serial_write_newline();
+
+		return;
+	}
+
+	if (serial_get_tx_hook() != 0)
+	{
+		return;
+	}
+
+	// The command is run again on each refresh, so it needs its own copy of the string.
+	char cmd_buf[32];
+	strncpy(cmd_buf, cmd, sizeof(cmd_buf) - 1);
+	cmd_buf[sizeof(cmd_buf) - 1] = 0x00;
+
+	_cap.screen = rbuf_borrow(PSTR("watch"));
+	if (_cap.screen == 0)
+	{
+		serial_write_P(PSTR("no free buffer"));
+		serial_write_newline();
+
+		return;
+	}
+
+	memset(_cap.screen, ' ', WATCH_ROWS * WATCH_COLS);
+
+	term_set_cursor(false);
+	term_clear_screen();
+
+	char buf[48];
+	sprintf_P(buf, PSTR("Every %us: %s"), interval, cmd_buf);
+	serial_write(buf, strlen(buf));
+
+	timer_notify_t notify;
+	timer_get_tick_count(notify.t);
+
+	do
+	{
+		_cap.x = 0;
+		_cap.y = 0;
+		_cap.row_end = 0;
+		_cap.esc = false;
+		_cap.draw_y = 0xff;
+
+		serial_set_tx_hook(&capture_byte);
+		command_process(cmd_buf);
+		serial_set_tx_hook(0);
+
+		capture_end();
+	} while (wait_for_next(&notify, interval));
+
+	rbuf_give_back(_cap.screen);
+
+	term_move_cursor(1, WATCH_TOP_Y + WATCH_ROWS);
+	term_set_cursor(true);
+	serial_write_newline();
+}
+
+
+static bool parse_args(const char* str, unsigned short* interval, const char** cmd)
+{
+	str += 5; // Skip the "watch" command at the beginning.
+
+	*interval = WATCH_DEFAULT_INTERVAL;
+
+	while (*str == ' ')
+	{
+		str++;
+	}
+
+	if (str[0] == '-' && str[1] == 'n')
+	{
+		str += 2;
+		while (*str == ' ')
+		{
+			str++;
+		}
+
+		if (!util_is_numeric(*str))
+		{
+			return false;
+		}
+
+		*interval = 0;
+		while (util_is_numeric(*str))
+		{
+			*interval = *interval * 10 + (*str - '0');
+			str++;
+		}
+
+		while (*str == ' ')
+		{
+			str++;
+		}
+	}
+
+	*cmd = str;
+
+	return (*interval != 0 && *str != 0x00);
+}
+
+static void capture_byte(unsigned char c)
+{
+	// Skip over any VT100 escape sequences in the output.
+	if (_cap.esc)
+	{
+		if (c >= 0x40 && c <= 0x7e && c != '[')
+		{
+			_cap.esc = false;
+		}
+		return;
+	}
+
+	if (c == 0x1b)
+	{
+		_cap.esc = true;
+	}
+	else if (c == '\r')
+	{
+		_cap.x = 0;
+	}
+	else if (c == '\n')
+	{
+		if (_cap.y < WATCH_ROWS)
+		{
+			blank_row(_cap.y, _cap.row_end);
+			_cap.y++;
+		}
+		_cap.row_end = 0;
+	}
+	else if (c >= 0x20 && c <= 0x7e && _cap.x < WATCH_COLS && _cap.y < WATCH_ROWS)
+	{
+		set_char(_cap.x, _cap.y, c);
+
+		if (++_cap.x > _cap.row_end)
+		{
+			_cap.row_end = _cap.x;
+		}
+	}
+}
+
+// Blanks out anything from the previous output which this output did not cover.
+static void capture_end()
+{
+	for (unsigned char y = _cap.y; y < WATCH_ROWS; y++)
+	{
+		blank_row(y, (y == _cap.y ? _cap.row_end : 0));
+	}
+}
+
+static void blank_row(unsigned char y, unsigned char x)
+{
+	for (; x < WATCH_COLS; x++)
+	{
+		set_char(x, y, ' ');
+	}
+}
+
+// Draws the char at once if it changed. It is called from the TX hook, which is
+// taken off while drawing.
+static void set_char(unsigned char x, unsigned char y, unsigned char c)
+{
+	unsigned char* row = _cap.screen + y * WATCH_COLS;
+	if (row[x] == c)
+	{
+		return;
+	}
+	row[x] = c;
+
+	serial_set_tx_hook(0);
+
+	if (_cap.draw_y == y && _cap.draw_x <= x && x - _cap.draw_x < term_move_cost(x + 1, y + WATCH_TOP_Y))
+	{
+		// Cheaper to just rewrite the unchanged chars in between.
+		term_write(row + _cap.draw_x, x - _cap.draw_x);
+	}
+	else
+	{
+		term_move_cursor(x + 1, y + WATCH_TOP_Y);
+	}
+
+	term_write(row + x, 1);
+	_cap.draw_x = x + 1;
+	_cap.draw_y = y;
+
+	serial_set_tx_hook(&capture_byte);
+}
+
+static bool wait_for_next(timer_notify_t* notify, unsigned short interval)
+{
+	unsigned short t[2];
+	timer_get_tick_count(t);
+
+	// Keep a steady cadence, unless the command itself took longer than the interval.
+	timer_add_seconds(notify->t, interval);
+	if (timer_compare(notify->t, t) <= 0)
+	{
+		notify->t[0] = t[0];
+		notify->t[1] = t[1];
+		timer_add_seconds(notify->t, interval);
+	}
+
+	if (!timer_notify_register(notify))
+	{
+		return false;
+	}
+
+	while (!notify->notify)
+	{
+		pm_yield();
+
+		if (serial_has_next_byte())
+		{
+			const unsigned char c = serial_read_next_byte();
+			if (c == QUIT_C || c == ABORT_C)
+			{
+				timer_notify_unregister(notify);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
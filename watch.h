@@ -0,0 +1,6 @@
+#ifndef _WATCH_H_
+#define _WATCH_H_
+
+void watch_main(const char* str);
+
+#endif // _WATCH_H_
@@ -1,38 +1,172 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "wc.h"
 
+#include "fmt.h"
 #include "serial.h"
 
+// Lines end with CR, LF or CRLF. A word is a run of anything other than spaces,
+// tabs and line endings.
+
+#define WC_BLOCK_SIZE 32
+
+#define OPT_LINES 0x01
+#define OPT_WORDS 0x02
+#define OPT_BYTES 0x04
+
+
+static bool parse_args(const char* str, unsigned char* opts);
+static void write_count(unsigned long n, bool padded, bool* first);
+
+
 void wc_main(void* arg)
 {
-	unsigned short l = 0;
-	unsigned short w = 0;
-	unsigned short c = 0;
+	const char* str = (const char*) arg;
+	unsigned char opts;
+
+	if (!parse_args(str, &opts))
+	{
+		serial_write_P(PSTR("bad args"));
+		serial_write_newline();
 
+		return;
+	}
+
+	unsigned long l = 0;
+	unsigned long w = 0;
+	unsigned long c = 0;
+
+	bool in_word = false;
+	bool after_cr = false;
+
+	unsigned char block[WC_BLOCK_SIZE];
 	bool run = true;
 	while (run)
 	{
-		unsigned char d = serial_read_next_byte();
-		switch (d)
+		const unsigned char n = serial_read_block(block, sizeof(block));
+
+		for (unsigned char i = 0; i < n; i++)
 		{
-		case 0x03:
-			return;
-		case 0x04:
-			run = false;
-			break;
-		case '\n':
-			l++;
-		case ' ':
-			w++;
-		default:
+			const unsigned char d = block[i];
+
+			if (d == 0x03)
+			{
+				return;
+			}
+			else if (d == 0x04)
+			{
+				run = false;
+				break;
+			}
+
 			c++;
+
+			if (d == '\r' || (d == '\n' && !after_cr))
+			{
+				l++;
+			}
+			after_cr = (d == '\r');
+
+			if (d == ' ' || d == '\t' || d == '\r' || d == '\n')
+			{
+				in_word = false;
+			}
+			else if (!in_word)
+			{
+				in_word = true;
+				w++;
+			}
 		}
 	}
 
-	char buf[20];
-	sprintf(buf, "%6u%6u%6u", l, w, c);
-	serial_write(buf, strlen(buf));
+	// A single count is written without padding, so it can be used as is.
+	const bool padded = ((opts & (opts - 1)) != 0);
+	bool first = true;
+
+	if ((opts & OPT_LINES) != 0)
+	{
+		write_count(l, padded, &first);
+	}
+	if ((opts & OPT_WORDS) != 0)
+	{
+		write_count(w, padded, &first);
+	}
+	if ((opts & OPT_BYTES) != 0)
+	{
+		write_count(c, padded, &first);
+	}
 	serial_write_newline();
 }
+
+static bool parse_args(const char* str, unsigned char* opts)
+{
+	str += 2; // Skip the "wc" command at the beginning.
+
+	*opts = 0;
+
+	while (*str != 0x00)
+	{
+		// Next char must be a space.
+		if (*str != ' ')
+		{
+			return false;
+		}
+
+		// Skip all remaining spaces.
+		while (*str == ' ')
+		{
+			str++;
+		}
+
+		if (*str == 0x00)
+		{
+			break;
+		}
+
+		if (*str != '-')
+		{
+			return false;
+		}
+
+		for (str++; *str != ' ' && *str != 0x00; str++)
+		{
+			switch (*str)
+			{
+			case 'l':
+				*opts |= OPT_LINES;
+				break;
+			case 'w':
+				*opts |= OPT_WORDS;
+				break;
+			case 'c':
+				*opts |= OPT_BYTES;
+				break;
+			default:
+				return false;
+			}
+		}
+	}
+
+	if (*opts == 0)
+	{
+		*opts = (OPT_LINES | OPT_WORDS | OPT_BYTES);
+	}
+
+	return true;
+}
+
+static void write_count(unsigned long n, bool padded, bool* first)
+{
+	char buf[FMT_U32_MAX_LEN];
+
+	if (!*first)
+	{
+		serial_tx_byte(' ');
+	}
+	*first = false;
+
+	serial_write(buf, fmt_u32_pad(buf, n, (padded ? 7 : 0), ' '));
+}
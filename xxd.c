@@ -0,0 +1,108 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xxd.h"
+
+#include "fmt.h"
+#include "serial.h"
+
+// Writes each 16 bytes of input as one line, in the same layout as "xxd":
+//
+// 00000000: 6865 6c6c 6f0d 0a                        hello..
+//
+// Input still ends at the first 0x04 (and stops at 0x03), as for every other
+// command, so binary input containing those bytes is cut short.
+
+#define XXD_ROW_BYTES 16
+#define XXD_BLOCK_SIZE 16
+
+// Offset, ": ", hex in groups of two bytes, two spaces, then the chars.
+#define XXD_HEX_COL 10
+#define XXD_CHAR_COL (XXD_HEX_COL + (XXD_ROW_BYTES * 5 / 2) + 1)
+#define XXD_LINE_LEN (XXD_CHAR_COL + XXD_ROW_BYTES)
+
+
+static void write_row(unsigned long offset, const unsigned char* row, unsigned char len);
+
+
+void xxd_main(void* arg)
+{
+	unsigned char row[XXD_ROW_BYTES];
+	unsigned char row_len = 0;
+	unsigned long offset = 0;
+
+	unsigned char block[XXD_BLOCK_SIZE];
+	bool run = true;
+	while (run)
+	{
+		const unsigned char n = serial_read_block(block, sizeof(block));
+
+		for (unsigned char i = 0; i < n; i++)
+		{
+			const unsigned char c = block[i];
+
+			if (c == 0x03)
+			{
+				return;
+			}
+			else if (c == 0x04)
+			{
+				run = false;
+				break;
+			}
+
+			row[row_len++] = c;
+			if (row_len == XXD_ROW_BYTES)
+			{
+				write_row(offset, row, row_len);
+				offset += row_len;
+				row_len = 0;
+			}
+		}
+	}
+
+	if (row_len != 0)
+	{
+		write_row(offset, row, row_len);
+	}
+}
+
+static void write_row(unsigned long offset, const unsigned char* row, unsigned char len)
+{
+	char line[XXD_LINE_LEN + 1];
+
+	fmt_hex(line, offset >> 16, 4);
+	fmt_hex(line + 4, offset, 4);
+	line[8] = ':';
+
+	memset(line + 9, ' ', XXD_CHAR_COL - 9);
+
+	char* p = line + XXD_HEX_COL;
+	for (unsigned char i = 0; i < len; i++)
+	{
+		fmt_hex(p, row[i], 2);
+		p += 2;
+
+		// A space after every second byte.
+		if ((i & 0x01) != 0)
+		{
+			*p++ = ' ';
+		}
+	}
+
+	// fmt_hex() wrote a null terminator after the last byte.
+	if ((len & 0x01) != 0)
+	{
+		*p = ' ';
+	}
+
+	for (unsigned char i = 0; i < len; i++)
+	{
+		const unsigned char c = row[i];
+		line[XXD_CHAR_COL + i] = ((c >= 0x20 && c < 0x7f) ? c : '.');
+	}
+
+	serial_write(line, XXD_CHAR_COL + len);
+	serial_write_newline();
+}
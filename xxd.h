@@ -0,0 +1,6 @@
+#ifndef _XXD_H_
+#define _XXD_H_
+
+void xxd_main(void* arg);
+
+#endif // _XXD_H_